@@ -0,0 +1,129 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AdpfPidController.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+void adpfPidUpdateTarget(const AdpfPidConfig &config, AdpfPidState *state,
+                         int64_t oldTargetNanos, int64_t newTargetNanos) {
+    double ratio =
+            newTargetNanos == 0 ? 1.0 : static_cast<double>(oldTargetNanos) / newTargetNanos;
+    state->integralError = std::max(config.integralInit(),
+                                    static_cast<int64_t>(state->integralError * ratio));
+}
+
+AdpfPidConfig adpfPidConfigForRefreshRate(const AdpfPidConfig &config, int refreshRate) {
+    AdpfPidConfig scaled = config;
+    if (refreshRate <= 0) {
+        return scaled;
+    }
+    const double factor = refreshRate / 60.0;
+    scaled.pOver *= factor;
+    scaled.pUnder *= factor;
+    scaled.dOver *= factor;
+    scaled.dUnder *= factor;
+    return scaled;
+}
+
+int64_t adpfSnapToVsync(int64_t targetNanos, int refreshRate) {
+    if (refreshRate <= 0) {
+        return targetNanos;
+    }
+    const int64_t period = 1000000000LL / refreshRate;
+    const int64_t frames = (targetNanos + period / 2) / period;
+    if (frames < 1) {
+        return targetNanos;
+    }
+    const int64_t snapped = frames * period;
+    return std::abs(targetNanos - snapped) <= period / 20 ? snapped : targetNanos;
+}
+
+void AdpfFeedForward::learn(int64_t targetNanos, int32_t uclampMin) {
+    const int64_t target = adpf_ns_to_100us(targetNanos);
+    if (target <= 0) {
+        return;
+    }
+    Entry *victim = &mEntries[0];
+    for (Entry &entry : mEntries) {
+        if (entry.target == target) {
+            // Smooth over frames so one lucky frame does not drag it down.
+            entry.uclampMin = (entry.uclampMin * 3 + uclampMin) / 4;
+            entry.lastUsed = ++mClock;
+            return;
+        }
+        if (entry.lastUsed < victim->lastUsed) {
+            victim = &entry;
+        }
+    }
+    victim->target = target;
+    victim->uclampMin = uclampMin;
+    victim->lastUsed = ++mClock;
+}
+
+bool AdpfFeedForward::lookup(int64_t targetNanos, int32_t *uclampMin) const {
+    const int64_t target = adpf_ns_to_100us(targetNanos);
+    for (const Entry &entry : mEntries) {
+        if (entry.target != 0 && entry.target == target) {
+            *uclampMin = entry.uclampMin;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AdpfFeedForward::seed(const AdpfPidConfig &config, int64_t targetNanos,
+                           AdpfPidState *state, int32_t *uclampMin) const {
+    int32_t learned;
+    if (config.i == 0 || !lookup(targetNanos, &learned)) {
+        return false;
+    }
+    learned = std::min(std::max(learned, config.uclampMinLowLimit), config.uclampMinHighLimit);
+    // With no error the output is just the integral term.
+    state->integralError =
+            std::min(config.integralHighLimit(),
+                     std::max(config.integralLowLimit(), static_cast<int64_t>(learned / config.i)));
+    state->previousError = 0;
+    *uclampMin = learned;
+    return true;
+}
+
+bool adpfPidNextUclampMin(const AdpfPidConfig &config, int64_t output, int32_t currentMin,
+                          int32_t *nextMin) {
+    if (output == 0) {
+        return false;
+    }
+    int32_t next_min = static_cast<int32_t>(
+            std::min(static_cast<int64_t>(config.uclampMinHighLimit), output));
+    next_min = std::max(config.uclampMinLowLimit, next_min);
+    if (std::abs(currentMin - next_min) <= static_cast<int32_t>(config.uclampMinGranularity)) {
+        return false;
+    }
+    *nextMin = next_min;
+    return true;
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
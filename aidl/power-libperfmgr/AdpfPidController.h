@@ -0,0 +1,182 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// ADPF PID controller tunables. The integral init/limits are expressed in
+// uclamp units, like the vendor.powerhal.adpf.pid_i.* properties.
+struct AdpfPidConfig {
+    double pOver = 2.0;
+    double pUnder = 1.0;
+    double i = 0.001;
+    double dOver = 500.0;
+    double dUnder = 0.0;
+    int64_t iInit = 200;
+    int64_t iHighLimit = 512;
+    int64_t iLowLimit = -30;
+    int64_t pSamplingWindow = 1;
+    int64_t iSamplingWindow = 0;
+    int64_t dSamplingWindow = 1;
+    int32_t uclampMinHighLimit = 384;
+    int32_t uclampMinLowLimit = 2;
+    uint32_t uclampMinGranularity = 5;
+
+    // Integral error bounds in controller units (uclamp units / i).
+    int64_t integralInit() const { return toIntegral(iInit); }
+    int64_t integralHighLimit() const { return toIntegral(iHighLimit); }
+    int64_t integralLowLimit() const { return toIntegral(iLowLimit); }
+
+  private:
+    int64_t toIntegral(int64_t value) const {
+        return i == 0 ? 0 : static_cast<int64_t>(value / i);
+    }
+};
+
+struct AdpfPidState {
+    int64_t integralError = 0;
+    int64_t previousError = 0;
+};
+
+struct AdpfPidOutput {
+    // Averages over the P/D sampling windows, in 100us units.
+    int64_t errAvg = 0;
+    int64_t derivativeAvg = 0;
+    int64_t pOut = 0;
+    int64_t iOut = 0;
+    int64_t dOut = 0;
+    int64_t output = 0;
+    bool overtime = false;
+    // Samples that were more than 20x away from the target.
+    size_t outliers = 0;
+};
+
+static inline int64_t adpf_ns_to_100us(int64_t ns) {
+    return ns / 100000;
+}
+
+// Runs one PID step over |length| work durations. |durationAt(i)| returns the
+// i-th actual duration in nanoseconds; it is a template parameter so that
+// callers can feed their own sample containers without copying.
+template <typename DurationAt>
+AdpfPidOutput adpfPidStep(const AdpfPidConfig &config, AdpfPidState *state,
+                          int64_t targetDurationNanos, int64_t length, DurationAt durationAt) {
+    AdpfPidOutput out;
+    const int64_t p_start = config.pSamplingWindow == 0 || config.pSamplingWindow > length
+                                    ? 0
+                                    : length - config.pSamplingWindow;
+    const int64_t i_start = config.iSamplingWindow == 0 || config.iSamplingWindow > length
+                                    ? 0
+                                    : length - config.iSamplingWindow;
+    const int64_t d_start = config.dSamplingWindow == 0 || config.dSamplingWindow > length
+                                    ? 0
+                                    : length - config.dSamplingWindow;
+    const int64_t integralHighLimit = config.integralHighLimit();
+    const int64_t integralLowLimit = config.integralLowLimit();
+    const int64_t dt = adpf_ns_to_100us(targetDurationNanos);
+    int64_t err_sum = 0;
+    int64_t derivative_sum = 0;
+    for (int64_t i = std::min({p_start, i_start, d_start}); i < length; i++) {
+        const int64_t actualDurationNanos = durationAt(i);
+        if (std::abs(actualDurationNanos) > targetDurationNanos * 20) {
+            out.outliers++;
+        }
+        // PID control algorithm
+        const int64_t error = adpf_ns_to_100us(actualDurationNanos - targetDurationNanos);
+        if (i >= d_start) {
+            derivative_sum += error - state->previousError;
+        }
+        if (i >= p_start) {
+            err_sum += error;
+        }
+        if (i >= i_start) {
+            state->integralError = state->integralError + error * dt;
+            state->integralError = std::min(integralHighLimit, state->integralError);
+            state->integralError = std::max(integralLowLimit, state->integralError);
+        }
+        state->previousError = error;
+    }
+    out.errAvg = err_sum / (length - p_start);
+    out.derivativeAvg = derivative_sum / dt / (length - d_start);
+    out.pOut = static_cast<int64_t>((err_sum > 0 ? config.pOver : config.pUnder) * err_sum /
+                                    (length - p_start));
+    out.iOut = static_cast<int64_t>(config.i * state->integralError);
+    out.dOut = static_cast<int64_t>((derivative_sum > 0 ? config.dOver : config.dUnder) *
+                                    derivative_sum / dt / (length - d_start));
+    out.output = out.pOut + out.iOut + out.dOut;
+    out.overtime = err_sum > 0;
+    return out;
+}
+
+// Remembers, per target duration, the uclamp.min that met the target, so the
+// controller can start from it instead of converging from scratch.
+class AdpfFeedForward {
+  public:
+    // Records that |uclampMin| met |targetNanos|.
+    void learn(int64_t targetNanos, int32_t uclampMin);
+    bool lookup(int64_t targetNanos, int32_t *uclampMin) const;
+    // Seeds the integral so the PID output starts at the learned uclamp.min
+    // for |targetNanos|. Returns false if nothing was learned for it.
+    bool seed(const AdpfPidConfig &config, int64_t targetNanos, AdpfPidState *state,
+              int32_t *uclampMin) const;
+
+  private:
+    static constexpr size_t kEntries = 8;
+    struct Entry {
+        // Target duration in 100us units, 0 if unused.
+        int64_t target = 0;
+        int32_t uclampMin = 0;
+        uint64_t lastUsed = 0;
+    };
+    Entry mEntries[kEntries];
+    uint64_t mClock = 0;
+};
+
+// Scales the P and D gains by |refreshRate| / 60 so that the same error in
+// nanoseconds weighs more when the frame budget is shorter.
+AdpfPidConfig adpfPidConfigForRefreshRate(const AdpfPidConfig &config, int refreshRate);
+
+// Snaps |targetNanos| to the closest multiple of the vsync period if it is
+// within 5% of it, so targets that are approximations of the frame budget
+// line up with the deadline the panel actually enforces.
+int64_t adpfSnapToVsync(int64_t targetNanos, int refreshRate);
+
+// Rescales the integral error when the target duration changes.
+void adpfPidUpdateTarget(const AdpfPidConfig &config, AdpfPidState *state,
+                         int64_t oldTargetNanos, int64_t newTargetNanos);
+
+// Maps a PID output to the next uclamp.min. Returns false if the current
+// value should be kept.
+bool adpfPidNextUclampMin(const AdpfPidConfig &config, int64_t output, int32_t currentMin,
+                          int32_t *nextMin);
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
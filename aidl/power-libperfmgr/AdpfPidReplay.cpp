@@ -0,0 +1,333 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays recorded work durations through the ADPF PID controller on the host.
+ *
+ * Input is CSV, one work duration per line:
+ *
+ *     timestamp_ns,duration_ns,target_ns[,report_id]
+ *
+ * Consecutive lines with the same report_id form one reportActualWorkDuration()
+ * batch; without a report_id every line is its own report. Empty lines, lines
+ * starting with '#' and a non-numeric header line are ignored.
+ *
+ * The replay is open loop: the recorded durations are not affected by the
+ * uclamp.min the controller picks, so the results describe how the controller
+ * reacts to a workload, not how the workload reacts to the controller.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "AdpfPidController.h"
+
+using aidl::google::hardware::power::impl::pixel::AdpfFeedForward;
+using aidl::google::hardware::power::impl::pixel::AdpfPidConfig;
+using aidl::google::hardware::power::impl::pixel::AdpfPidOutput;
+using aidl::google::hardware::power::impl::pixel::adpfPidNextUclampMin;
+using aidl::google::hardware::power::impl::pixel::AdpfPidState;
+using aidl::google::hardware::power::impl::pixel::adpfPidStep;
+using aidl::google::hardware::power::impl::pixel::adpfPidUpdateTarget;
+
+struct Sample {
+    int64_t timestamp;
+    int64_t duration;
+    int64_t target;
+    int64_t report;
+};
+
+struct Report {
+    size_t begin;
+    size_t end;
+};
+
+// A run of reports with the same target duration.
+struct Segment {
+    int64_t target;
+    size_t firstReport;
+    size_t lastReport;
+};
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [options] <trace.csv | ->\n"
+            "  --p_over=F --p_under=F --i=F --d_over=F --d_under=F\n"
+            "  --i_init=N --i_high=N --i_low=N\n"
+            "  --p_window=N --i_window=N --d_window=N\n"
+            "  --uclamp_high=N --uclamp_low=N --granularity=N\n"
+            "  --feed_forward   seed the controller with learned values on target change\n"
+            "  --trajectory     print the per-report controller state as CSV\n",
+            argv0);
+}
+
+static bool parseLine(char *line, int64_t lineNo, Sample *sample) {
+    char *p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '\0' || *p == '\n' || *p == '#') {
+        return false;
+    }
+    int64_t fields[4];
+    int count = 0;
+    char *end;
+    while (count < 4) {
+        fields[count] = strtoll(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        count++;
+        p = end;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p != ',') {
+            break;
+        }
+        p++;
+    }
+    if (count < 3) {
+        if (lineNo > 1) {
+            fprintf(stderr, "line %" PRId64 ": expected timestamp_ns,duration_ns,target_ns\n",
+                    lineNo);
+        }
+        return false;
+    }
+    sample->timestamp = fields[0];
+    sample->duration = fields[1];
+    sample->target = fields[2];
+    sample->report = count == 4 ? fields[3] : lineNo;
+    return true;
+}
+
+static bool readTrace(FILE *in, std::vector<Sample> *samples) {
+    char line[512];
+    int64_t lineNo = 0;
+    while (fgets(line, sizeof(line), in)) {
+        Sample sample;
+        lineNo++;
+        if (parseLine(line, lineNo, &sample)) {
+            if (sample.target <= 0) {
+                fprintf(stderr, "line %" PRId64 ": target must be positive\n", lineNo);
+                return false;
+            }
+            samples->push_back(sample);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    AdpfPidConfig config;
+    bool trajectory = false;
+    bool feedForward = false;
+    enum {
+        OPT_P_OVER = 1,
+        OPT_P_UNDER,
+        OPT_I,
+        OPT_D_OVER,
+        OPT_D_UNDER,
+        OPT_I_INIT,
+        OPT_I_HIGH,
+        OPT_I_LOW,
+        OPT_P_WINDOW,
+        OPT_I_WINDOW,
+        OPT_D_WINDOW,
+        OPT_UCLAMP_HIGH,
+        OPT_UCLAMP_LOW,
+        OPT_GRANULARITY,
+        OPT_FEED_FORWARD,
+        OPT_TRAJECTORY,
+        OPT_HELP,
+    };
+    static const struct option kOptions[] = {
+            {"p_over", required_argument, nullptr, OPT_P_OVER},
+            {"p_under", required_argument, nullptr, OPT_P_UNDER},
+            {"i", required_argument, nullptr, OPT_I},
+            {"d_over", required_argument, nullptr, OPT_D_OVER},
+            {"d_under", required_argument, nullptr, OPT_D_UNDER},
+            {"i_init", required_argument, nullptr, OPT_I_INIT},
+            {"i_high", required_argument, nullptr, OPT_I_HIGH},
+            {"i_low", required_argument, nullptr, OPT_I_LOW},
+            {"p_window", required_argument, nullptr, OPT_P_WINDOW},
+            {"i_window", required_argument, nullptr, OPT_I_WINDOW},
+            {"d_window", required_argument, nullptr, OPT_D_WINDOW},
+            {"uclamp_high", required_argument, nullptr, OPT_UCLAMP_HIGH},
+            {"uclamp_low", required_argument, nullptr, OPT_UCLAMP_LOW},
+            {"granularity", required_argument, nullptr, OPT_GRANULARITY},
+            {"feed_forward", no_argument, nullptr, OPT_FEED_FORWARD},
+            {"trajectory", no_argument, nullptr, OPT_TRAJECTORY},
+            {"help", no_argument, nullptr, OPT_HELP},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", kOptions, nullptr)) != -1) {
+        switch (opt) {
+            case OPT_P_OVER: config.pOver = strtod(optarg, nullptr); break;
+            case OPT_P_UNDER: config.pUnder = strtod(optarg, nullptr); break;
+            case OPT_I: config.i = strtod(optarg, nullptr); break;
+            case OPT_D_OVER: config.dOver = strtod(optarg, nullptr); break;
+            case OPT_D_UNDER: config.dUnder = strtod(optarg, nullptr); break;
+            case OPT_I_INIT: config.iInit = strtoll(optarg, nullptr, 10); break;
+            case OPT_I_HIGH: config.iHighLimit = strtoll(optarg, nullptr, 10); break;
+            case OPT_I_LOW: config.iLowLimit = strtoll(optarg, nullptr, 10); break;
+            case OPT_P_WINDOW: config.pSamplingWindow = strtoll(optarg, nullptr, 10); break;
+            case OPT_I_WINDOW: config.iSamplingWindow = strtoll(optarg, nullptr, 10); break;
+            case OPT_D_WINDOW: config.dSamplingWindow = strtoll(optarg, nullptr, 10); break;
+            case OPT_UCLAMP_HIGH: config.uclampMinHighLimit = atoi(optarg); break;
+            case OPT_UCLAMP_LOW: config.uclampMinLowLimit = atoi(optarg); break;
+            case OPT_GRANULARITY: config.uclampMinGranularity = atoi(optarg); break;
+            case OPT_FEED_FORWARD: feedForward = true; break;
+            case OPT_TRAJECTORY: trajectory = true; break;
+            default:
+                usage(argv[0]);
+                return opt == OPT_HELP ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *in = strcmp(argv[optind], "-") == 0 ? stdin : fopen(argv[optind], "r");
+    if (!in) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    std::vector<Sample> samples;
+    bool ok = readTrace(in, &samples);
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (!ok) {
+        return EXIT_FAILURE;
+    }
+    if (samples.empty()) {
+        fprintf(stderr, "no samples in %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Report> reports;
+    for (size_t i = 0; i < samples.size(); i++) {
+        if (reports.empty() || samples[i].report != samples[reports.back().begin].report ||
+            samples[i].target != samples[reports.back().begin].target) {
+            reports.push_back({i, i + 1});
+        } else {
+            reports.back().end = i + 1;
+        }
+    }
+
+    // Same initial state as a freshly created PowerHintSession.
+    AdpfPidState state;
+    AdpfFeedForward ff;
+    state.integralError = config.integralInit();
+    int32_t uclampMin = config.uclampMinHighLimit;
+    int64_t target = samples[0].target;
+    std::vector<int32_t> uclampTrajectory;
+    std::vector<Segment> segments;
+    segments.push_back({target, 0, 0});
+    size_t missed = 0;
+
+    if (trajectory) {
+        printf("report,timestamp_ns,target_ns,actual_last_ns,samples,err,integral,pOut,iOut,dOut,"
+               "output,uclamp_min\n");
+    }
+    for (size_t r = 0; r < reports.size(); r++) {
+        const Report &report = reports[r];
+        const int64_t reportTarget = samples[report.begin].target;
+        if (reportTarget != target) {
+            int32_t learnedMin;
+            if (feedForward && ff.seed(config, reportTarget, &state, &learnedMin)) {
+                uclampMin = learnedMin;
+            } else {
+                adpfPidUpdateTarget(config, &state, target, reportTarget);
+            }
+            target = reportTarget;
+            segments.push_back({target, r, r});
+        }
+        const int64_t length = report.end - report.begin;
+        const AdpfPidOutput out =
+                adpfPidStep(config, &state, target, length, [&](int64_t i) {
+                    return samples[report.begin + i].duration;
+                });
+        for (size_t i = report.begin; i < report.end; i++) {
+            if (samples[i].duration > target) {
+                missed++;
+            }
+        }
+        if (feedForward && !out.overtime) {
+            ff.learn(target, uclampMin);
+        }
+        int32_t nextMin;
+        if (adpfPidNextUclampMin(config, out.output, uclampMin, &nextMin)) {
+            uclampMin = nextMin;
+        }
+        uclampTrajectory.push_back(uclampMin);
+        segments.back().lastReport = r;
+        if (trajectory) {
+            printf("%zu,%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64
+                   ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%d\n",
+                   r, samples[report.end - 1].timestamp, target, samples[report.end - 1].duration,
+                   length, out.errAvg, state.integralError, out.pOut, out.iOut, out.dOut,
+                   out.output, uclampMin);
+        }
+    }
+
+    // Per target segment: overshoot of uclamp.min above the value it ends at,
+    // and the time until it stays within the granularity band of that value.
+    int32_t maxOvershoot = 0;
+    double sumOvershoot = 0;
+    int64_t maxSettleNs = 0;
+    double sumSettleNs = 0;
+    for (const Segment &segment : segments) {
+        const int32_t settled = uclampTrajectory[segment.lastReport];
+        int32_t peak = settled;
+        size_t settleReport = segment.firstReport;
+        for (size_t r = segment.firstReport; r <= segment.lastReport; r++) {
+            peak = std::max(peak, uclampTrajectory[r]);
+            if (std::abs(uclampTrajectory[r] - settled) >
+                static_cast<int32_t>(config.uclampMinGranularity)) {
+                settleReport = r + 1;
+            }
+        }
+        const int32_t overshoot = peak - settled;
+        maxOvershoot = std::max(maxOvershoot, overshoot);
+        sumOvershoot += overshoot;
+        const int64_t start = samples[reports[segment.firstReport].begin].timestamp;
+        const int64_t settledAt = samples[reports[settleReport].end - 1].timestamp;
+        const int64_t settleNs = std::max<int64_t>(0, settledAt - start);
+        maxSettleNs = std::max(maxSettleNs, settleNs);
+        sumSettleNs += settleNs;
+    }
+
+    FILE *summary = trajectory ? stderr : stdout;
+    fprintf(summary, "samples: %zu\n", samples.size());
+    fprintf(summary, "reports: %zu\n", reports.size());
+    fprintf(summary, "target segments: %zu\n", segments.size());
+    fprintf(summary, "missed deadlines: %zu (%.2f%%)\n", missed,
+            100.0 * missed / samples.size());
+    fprintf(summary, "final uclamp.min: %d\n", uclampTrajectory.back());
+    fprintf(summary, "uclamp.min overshoot: max %d, mean %.1f\n", maxOvershoot,
+            sumOvershoot / segments.size());
+    fprintf(summary, "settling time: max %.2f ms, mean %.2f ms\n", maxSettleNs / 1e6,
+            sumSettleNs / segments.size() / 1e6);
+    return EXIT_SUCCESS;
+}
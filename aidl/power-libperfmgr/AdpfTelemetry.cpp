@@ -0,0 +1,126 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AdpfTelemetry.h"
+
+#include <android-base/stringprintf.h>
+
+#include <inttypes.h>
+
+#include <algorithm>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::base::StringAppendF;
+
+namespace {
+
+static int64_t percentile(const std::vector<int64_t> &sorted, int pct) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = (sorted.size() * pct + 99) / 100;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+}  // namespace
+
+AdpfTelemetryRing::AdpfTelemetryRing(size_t capacity)
+    : mCapacity(capacity), mSlots(new Slot[capacity]), mHead(0) {}
+
+void AdpfTelemetryRing::push(const AdpfTelemetrySample &sample) {
+    const uint64_t index = mHead.load(std::memory_order_relaxed);
+    Slot &slot = mSlots[index % mCapacity];
+    const int64_t values[kFieldCount] = {sample.timestampNanos, sample.actualNanos,
+                                         sample.targetNanos,    sample.pOut,
+                                         sample.iOut,           sample.dOut,
+                                         sample.uclampMin};
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kFieldCount; i++) {
+        slot.fields[i].store(values[i], std::memory_order_relaxed);
+    }
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+    mHead.store(index + 1, std::memory_order_release);
+}
+
+std::vector<AdpfTelemetrySample> AdpfTelemetryRing::snapshot() const {
+    std::vector<AdpfTelemetrySample> samples;
+    const uint64_t head = mHead.load(std::memory_order_acquire);
+    const uint64_t first = head > mCapacity ? head - mCapacity : 0;
+    samples.reserve(head - first);
+    for (uint64_t index = first; index < head; index++) {
+        const Slot &slot = mSlots[index % mCapacity];
+        const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        int64_t values[kFieldCount];
+        for (size_t i = 0; i < kFieldCount; i++) {
+            values[i] = slot.fields[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq != 2 * index + 2 || slot.seq.load(std::memory_order_relaxed) != seq) {
+            // Overwritten by the writer while we were reading.
+            continue;
+        }
+        samples.push_back({values[0], values[1], values[2], values[3], values[4], values[5],
+                           values[6]});
+    }
+    return samples;
+}
+
+void AdpfTelemetryRing::dump(std::string *out) const {
+    const std::vector<AdpfTelemetrySample> samples = snapshot();
+    std::vector<int64_t> actual;
+    std::vector<int64_t> target;
+    actual.reserve(samples.size());
+    target.reserve(samples.size());
+    size_t missed = 0;
+    for (const auto &sample : samples) {
+        actual.push_back(sample.actualNanos);
+        target.push_back(sample.targetNanos);
+        if (sample.actualNanos > sample.targetNanos) {
+            missed++;
+        }
+    }
+    std::sort(actual.begin(), actual.end());
+    std::sort(target.begin(), target.end());
+    StringAppendF(out, "  telemetry: %zu/%zu samples, %zu over target\n", samples.size(),
+                  mCapacity, missed);
+    StringAppendF(out,
+                  "  actual p50/p90/p99: %" PRId64 "/%" PRId64 "/%" PRId64 " ns\n"
+                  "  target p50/p90/p99: %" PRId64 "/%" PRId64 "/%" PRId64 " ns\n",
+                  percentile(actual, 50), percentile(actual, 90), percentile(actual, 99),
+                  percentile(target, 50), percentile(target, 90), percentile(target, 99));
+    out->append("  timestamp_ns,actual_ns,target_ns,pOut,iOut,dOut,uclamp_min\n");
+    for (const auto &sample : samples) {
+        StringAppendF(out,
+                      "  %" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64
+                      ",%" PRId64 "\n",
+                      sample.timestampNanos, sample.actualNanos, sample.targetNanos, sample.pOut,
+                      sample.iOut, sample.dOut, sample.uclampMin);
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+struct AdpfTelemetrySample {
+    int64_t timestampNanos;
+    int64_t actualNanos;
+    int64_t targetNanos;
+    int64_t pOut;
+    int64_t iOut;
+    int64_t dOut;
+    int64_t uclampMin;
+};
+
+// Fixed-size ring of the most recent controller samples of one session.
+// There must be a single writer; readers may run concurrently and simply
+// skip slots that are being overwritten.
+class AdpfTelemetryRing {
+  public:
+    explicit AdpfTelemetryRing(size_t capacity);
+    void push(const AdpfTelemetrySample &sample);
+    // Returns the retained samples, oldest first.
+    std::vector<AdpfTelemetrySample> snapshot() const;
+    // Appends percentiles and the samples as CSV.
+    void dump(std::string *out) const;
+    size_t capacity() const { return mCapacity; }
+
+  private:
+    static constexpr size_t kFieldCount = 7;
+    struct Slot {
+        // 2 * index + 1 while slot index is written, 2 * index + 2 once done.
+        std::atomic<uint64_t> seq{0};
+        std::atomic<int64_t> fields[kFieldCount];
+    };
+    const size_t mCapacity;
+    std::unique_ptr<Slot[]> mSlots;
+    std::atomic<uint64_t> mHead;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
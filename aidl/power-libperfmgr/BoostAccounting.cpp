@@ -0,0 +1,241 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include "BoostAccounting.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <functional>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+constexpr size_t kDefaultTopConsumers = 5;
+
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+}  // namespace
+
+BoostAccounting::BoostAccounting() : mTopConsumers(kDefaultTopConsumers) {}
+
+std::unique_ptr<BoostAccounting> BoostAccounting::GetFromJSON(const std::string &config_path) {
+    std::unique_ptr<BoostAccounting> accounting(new BoostAccounting());
+    std::string json_doc;
+    if (!::android::base::ReadFileToString(config_path, &json_doc)) {
+        LOG(ERROR) << "Failed to read JSON config from " << config_path;
+        return accounting;
+    }
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(json_doc, root)) {
+        LOG(ERROR) << "Failed to parse JSON config: " << reader.getFormattedErrorMessages();
+        return accounting;
+    }
+    const Json::Value &section = root["BoostLimits"];
+    if (!section.isObject()) {
+        LOG(INFO) << "No BoostLimits in " << config_path;
+        return accounting;
+    }
+
+    if (section["TopConsumers"].isUInt()) {
+        accounting->mTopConsumers = section["TopConsumers"].asUInt();
+    }
+    const Json::Value &limits = section["Limits"];
+    for (Json::ArrayIndex i = 0; limits.isArray() && i < limits.size(); i++) {
+        const Json::Value &entry = limits[i];
+        Limit limit;
+        for (Json::ArrayIndex j = 0; entry["Hints"].isArray() && j < entry["Hints"].size(); j++) {
+            limit.hints.push_back(entry["Hints"][j].asString());
+        }
+        limit.callsPerSec = entry["CallsPerSec"].isNumeric() ? entry["CallsPerSec"].asDouble() : 0;
+        limit.burst = entry["Burst"].isNumeric() ? entry["Burst"].asDouble() : limit.callsPerSec;
+        limit.maxDurationMs = entry["MaxDurationMs"].isInt() ? entry["MaxDurationMs"].asInt() : 0;
+        limit.clampHeld = entry["ClampHeld"].isBool() && entry["ClampHeld"].asBool();
+        if (limit.hints.empty() || limit.callsPerSec <= 0 || limit.burst < 1) {
+            LOG(ERROR) << "Invalid boost limit[" << i << "]";
+            continue;
+        }
+        accounting->mLimits.push_back(std::move(limit));
+    }
+
+    LOG(INFO) << "BoostAccounting: " << accounting->mLimits.size() << " limits";
+    return accounting;
+}
+
+const BoostAccounting::Limit *BoostAccounting::FindLimit(const std::string &hint,
+                                                         size_t *index) const {
+    for (size_t i = 0; i < mLimits.size(); i++) {
+        const auto &hints = mLimits[i].hints;
+        if (std::find_if(hints.begin(), hints.end(), [&hint](const std::string &h) {
+                return h == "*" || h == hint;
+            }) != hints.end()) {
+            *index = i;
+            return &mLimits[i];
+        }
+    }
+    return nullptr;
+}
+
+int64_t BoostAccounting::TotalBoostMsLocked(const Usage &usage, int64_t now) const {
+    int64_t total = usage.boostMs;
+    for (const auto &held : usage.heldSinceNs) {
+        total += (now - held.second) / 1000000;
+    }
+    return total;
+}
+
+BoostAccounting::Usage &BoostAccounting::UsageLocked(uid_t uid, int64_t now) {
+    auto it = mUsage.find(uid);
+    if (it != mUsage.end()) {
+        return it->second;
+    }
+    if (mUsage.size() >= kMaxUids) {
+        // Forget the smallest consumer that is not holding anything.
+        auto victim = mUsage.end();
+        int64_t victimMs = INT64_MAX;
+        for (auto u = mUsage.begin(); u != mUsage.end(); ++u) {
+            const int64_t ms = TotalBoostMsLocked(u->second, now);
+            if (u->second.heldSinceNs.empty() && ms < victimMs) {
+                victim = u;
+                victimMs = ms;
+            }
+        }
+        if (victim != mUsage.end()) {
+            mUsage.erase(victim);
+        }
+    }
+    return mUsage[uid];
+}
+
+bool BoostAccounting::Admit(uid_t uid, const std::string &hint, int32_t *durationMs) {
+    const int64_t now = NowNs();
+    std::lock_guard<std::mutex> guard(mLock);
+    Usage &usage = UsageLocked(uid, now);
+    usage.calls++;
+    if (usage.lastCallNs > 0) {
+        const double interval = now - usage.lastCallNs;
+        usage.intervalNs =
+                usage.intervalNs > 0 ? (3 * usage.intervalNs + interval) / 4 : interval;
+    }
+    usage.lastCallNs = now;
+
+    size_t index;
+    const Limit *limit = FindLimit(hint, &index);
+    if (limit) {
+        auto bucket = usage.buckets.find(index);
+        if (bucket == usage.buckets.end()) {
+            bucket = usage.buckets.emplace(index, Bucket{limit->burst, now}).first;
+        }
+        Bucket &b = bucket->second;
+        b.tokens = std::min(limit->burst, b.tokens + (now - b.lastNs) * limit->callsPerSec / 1e9);
+        b.lastNs = now;
+        if (b.tokens < 1) {
+            // Log the first rejection and then every 100th.
+            if (usage.rejected++ % 100 == 0) {
+                LOG(WARNING) << "Boost " << hint << " from uid " << uid
+                             << " over limit, rejected " << usage.rejected;
+            }
+            return false;
+        }
+        b.tokens -= 1;
+        // Boosts held until ended are only timed out where the limit opts in.
+        if (limit->maxDurationMs > 0 && (*durationMs > limit->maxDurationMs ||
+                                         (*durationMs == 0 && limit->clampHeld))) {
+            *durationMs = limit->maxDurationMs;
+            usage.clamped++;
+        }
+    }
+    return true;
+}
+
+void BoostAccounting::Charge(uid_t uid, const std::string &hint, int32_t durationMs) {
+    const int64_t now = NowNs();
+    std::lock_guard<std::mutex> guard(mLock);
+    Usage &usage = UsageLocked(uid, now);
+    if (durationMs > 0) {
+        usage.boostMs += durationMs;
+    } else if (durationMs == 0) {
+        usage.heldSinceNs.emplace(hint, now);
+    }
+}
+
+void BoostAccounting::End(uid_t uid, const std::string &hint) {
+    const int64_t now = NowNs();
+    std::lock_guard<std::mutex> guard(mLock);
+    auto it = mUsage.find(uid);
+    if (it == mUsage.end()) {
+        return;
+    }
+    auto held = it->second.heldSinceNs.find(hint);
+    if (held != it->second.heldSinceNs.end()) {
+        it->second.boostMs += (now - held->second) / 1000000;
+        it->second.heldSinceNs.erase(held);
+    }
+}
+
+void BoostAccounting::DumpToFd(int fd) {
+    const int64_t now = NowNs();
+    std::string buf;
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        std::vector<std::pair<int64_t, uid_t>> consumers;
+        for (const auto &usage : mUsage) {
+            consumers.emplace_back(TotalBoostMsLocked(usage.second, now), usage.first);
+        }
+        const size_t top = std::min(mTopConsumers, consumers.size());
+        std::partial_sort(consumers.begin(), consumers.begin() + top, consumers.end(),
+                          std::greater<>());
+        buf = ::android::base::StringPrintf("Boost consumers (top %zu of %zu uids):\n", top,
+                                            consumers.size());
+        for (size_t i = 0; i < top; i++) {
+            const Usage &usage = mUsage[consumers[i].second];
+            ::android::base::StringAppendF(
+                    &buf,
+                    "  uid %u: %.1fs boosted, %" PRIu64 " calls (%.1f/s), %" PRIu64
+                    " rejected, %" PRIu64 " clamped, %zu held\n",
+                    consumers[i].second, consumers[i].first / 1000.0, usage.calls,
+                    usage.intervalNs > 0 ? 1e9 / usage.intervalNs : 0.0, usage.rejected,
+                    usage.clamped, usage.heldSinceNs.size());
+        }
+    }
+    if (!::android::base::WriteStringToFd(buf, fd)) {
+        PLOG(ERROR) << "Failed to dump boost accounting to fd";
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <json/json.h>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// Tracks PowerExt boosts per calling uid and rate limits them with token
+// buckets. Limits come from the "BoostLimits" section of powerhint.json:
+//
+//   "BoostLimits": {
+//       "TopConsumers": 5,
+//       "Limits": [
+//           { "Hints": ["CAMERA_SHOT"], "CallsPerSec": 20, "Burst": 40,
+//             "MaxDurationMs": 10000, "ClampHeld": true },
+//           { "Hints": ["*"], "CallsPerSec": 20, "Burst": 40 }
+//       ]
+//   }
+//
+// Each uid gets its own bucket per limit; the first limit listing a hint
+// applies to it. MaxDurationMs clamps timed boosts, 0 leaves them alone. With
+// ClampHeld it also turns boosts held until ended into timed ones.
+class BoostAccounting {
+  public:
+    // Returns an accounting without limits if the section is missing.
+    static std::unique_ptr<BoostAccounting> GetFromJSON(const std::string &config_path);
+    // Counts a call from |uid| for |hint| against its limit. Returns false if
+    // the call is over its limit and must be dropped. |durationMs| may be
+    // clamped, and a zero duration replaced by MaxDurationMs if the limit
+    // has ClampHeld.
+    bool Admit(uid_t uid, const std::string &hint, int32_t *durationMs);
+    // Charges |uid| for a boost that was actually issued for |durationMs|.
+    void Charge(uid_t uid, const std::string &hint, int32_t durationMs);
+    // Stops charging |uid| for a boost held with zero duration.
+    void End(uid_t uid, const std::string &hint);
+    void DumpToFd(int fd);
+
+  private:
+    static constexpr size_t kMaxUids = 128;
+    struct Limit {
+        std::vector<std::string> hints;
+        double callsPerSec;
+        double burst;
+        int32_t maxDurationMs;
+        bool clampHeld;
+    };
+    struct Bucket {
+        double tokens;
+        int64_t lastNs;
+    };
+    struct Usage {
+        uint64_t calls = 0;
+        uint64_t rejected = 0;
+        uint64_t clamped = 0;
+        int64_t boostMs = 0;
+        int64_t lastCallNs = 0;
+        // Smoothed time between calls.
+        double intervalNs = 0;
+        std::unordered_map<size_t, Bucket> buckets;
+        std::unordered_map<std::string, int64_t> heldSinceNs;
+    };
+    BoostAccounting();
+    const Limit *FindLimit(const std::string &hint, size_t *index) const;
+    Usage &UsageLocked(uid_t uid, int64_t now);
+    int64_t TotalBoostMsLocked(const Usage &usage, int64_t now) const;
+    std::vector<Limit> mLimits;
+    size_t mTopConsumers;
+    std::mutex mLock;
+    std::unordered_map<uid_t, Usage> mUsage;  // protected by mLock
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
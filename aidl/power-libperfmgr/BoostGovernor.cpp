@@ -0,0 +1,266 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
+
+#include "BoostGovernor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <utils/Trace.h>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+constexpr char kFakeTempProp[] = "vendor.powerhal.governor.fake_temp";
+constexpr char kFakeBatteryProp[] = "vendor.powerhal.governor.fake_battery";
+constexpr int64_t kDefaultPollIntervalMs = 5000;
+
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+static int ReadReading(const std::string &path, const char *fake_prop) {
+    const int fake = ::android::base::GetIntProperty(fake_prop, INT_MIN);
+    if (fake != INT_MIN) {
+        return fake;
+    }
+    std::string content;
+    int value;
+    if (path.empty() || !::android::base::ReadFileToString(path, &content) ||
+        !::android::base::ParseInt(::android::base::Trim(content), &value)) {
+        return INT_MIN;
+    }
+    return value;
+}
+
+static bool Matches(const std::vector<std::string> &hints, const std::string &hint) {
+    return std::find_if(hints.begin(), hints.end(), [&hint](const std::string &h) {
+               return h == "*" || h == hint;
+           }) != hints.end();
+}
+
+}  // namespace
+
+BoostGovernor::BoostGovernor()
+    : mPollIntervalNs(kDefaultPollIntervalMs * 1000000),
+      mTemp(INT_MIN),
+      mBattery(INT_MIN),
+      mLastPollNs(0),
+      mDropped(0),
+      mReplaced(0),
+      mScaled(0) {}
+
+std::unique_ptr<BoostGovernor> BoostGovernor::GetFromJSON(const std::string &config_path) {
+    std::unique_ptr<BoostGovernor> governor(new BoostGovernor());
+    std::string json_doc;
+    if (!::android::base::ReadFileToString(config_path, &json_doc)) {
+        LOG(ERROR) << "Failed to read JSON config from " << config_path;
+        return governor;
+    }
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(json_doc, root)) {
+        LOG(ERROR) << "Failed to parse JSON config: " << reader.getFormattedErrorMessages();
+        return governor;
+    }
+    const Json::Value &section = root["BoostGovernor"];
+    if (!section.isObject()) {
+        LOG(INFO) << "No BoostGovernor in " << config_path;
+        return governor;
+    }
+
+    governor->mThermalPath = section["ThermalPath"].asString();
+    governor->mBatteryPath = section["BatteryPath"].asString();
+    if (section["PollIntervalMs"].isUInt()) {
+        governor->mPollIntervalNs =
+                static_cast<int64_t>(section["PollIntervalMs"].asUInt()) * 1000000;
+    }
+
+    const Json::Value &policies = section["Policies"];
+    for (Json::ArrayIndex i = 0; policies.isArray() && i < policies.size(); i++) {
+        const Json::Value &entry = policies[i];
+        Policy policy;
+        for (Json::ArrayIndex j = 0; entry["Hints"].isArray() && j < entry["Hints"].size(); j++) {
+            policy.hints.push_back(entry["Hints"][j].asString());
+        }
+        policy.minTemp = entry["MinTemp"].isInt() ? entry["MinTemp"].asInt() : INT_MIN;
+        policy.maxBattery = entry["MaxBattery"].isInt() ? entry["MaxBattery"].asInt() : INT_MAX;
+        policy.replacement = entry["Replacement"].asString();
+        policy.durationScale = entry["DurationScale"].isNumeric()
+                                       ? entry["DurationScale"].asDouble()
+                                       : 1.0;
+        const std::string action = entry["Action"].asString();
+        if (action == "Drop") {
+            policy.action = Action::DROP;
+        } else if (action == "Replace" && !policy.replacement.empty()) {
+            policy.action = Action::REPLACE;
+        } else if (action == "Scale" && policy.durationScale > 0.0) {
+            policy.action = Action::SCALE;
+        } else {
+            LOG(ERROR) << "Invalid governor policy[" << i << "] action: " << action;
+            continue;
+        }
+        if (policy.hints.empty() ||
+            (policy.minTemp == INT_MIN && policy.maxBattery == INT_MAX)) {
+            LOG(ERROR) << "Governor policy[" << i << "] has no hints or conditions";
+            continue;
+        }
+        governor->mPolicies.push_back(std::move(policy));
+    }
+
+    LOG(INFO) << "BoostGovernor: " << governor->mPolicies.size() << " policies, thermal "
+              << governor->mThermalPath << ", battery " << governor->mBatteryPath;
+    return governor;
+}
+
+void BoostGovernor::Refresh() {
+    const int64_t now = NowNs();
+    if (now - mLastPollNs.load(std::memory_order_relaxed) < mPollIntervalNs) {
+        return;
+    }
+    // Whoever loses the race keeps using the previous readings.
+    std::unique_lock<std::mutex> lock(mPollLock, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+    const int temp = ReadReading(mThermalPath, kFakeTempProp);
+    const int battery = ReadReading(mBatteryPath, kFakeBatteryProp);
+    mTemp.store(temp, std::memory_order_relaxed);
+    mBattery.store(battery, std::memory_order_relaxed);
+    mLastPollNs.store(now, std::memory_order_relaxed);
+    ATRACE_INT("governor.temp", temp);
+    ATRACE_INT("governor.battery", battery);
+}
+
+const BoostGovernor::Policy *BoostGovernor::Match(const std::string &hint) {
+    if (mPolicies.empty()) {
+        return nullptr;
+    }
+    Refresh();
+    const int temp = mTemp.load(std::memory_order_relaxed);
+    const int battery = mBattery.load(std::memory_order_relaxed);
+    for (const auto &policy : mPolicies) {
+        if (!Matches(policy.hints, hint)) {
+            continue;
+        }
+        // A condition on a reading we could not get never holds.
+        if (policy.minTemp != INT_MIN && (temp == INT_MIN || temp < policy.minTemp)) {
+            continue;
+        }
+        if (policy.maxBattery != INT_MAX && (battery == INT_MIN || battery > policy.maxBattery)) {
+            continue;
+        }
+        return &policy;
+    }
+    return nullptr;
+}
+
+std::string BoostGovernor::Begin(const std::string &hint, int32_t *durationMs) {
+    const bool held = !durationMs || *durationMs == 0;
+    if (held) {
+        // Keep the first decision until End(), or the hint issued first leaks.
+        std::lock_guard<std::mutex> guard(mHeldLock);
+        auto it = mHeld.find(hint);
+        if (it != mHeld.end()) {
+            return it->second;
+        }
+    }
+    std::string issued = hint;
+    const Policy *policy = Match(hint);
+    if (policy) {
+        switch (policy->action) {
+            case Action::DROP:
+                issued.clear();
+                mDropped++;
+                break;
+            case Action::REPLACE:
+                issued = policy->replacement;
+                mReplaced++;
+                break;
+            case Action::SCALE:
+                if (durationMs && *durationMs > 0) {
+                    *durationMs = std::max<int32_t>(1, *durationMs * policy->durationScale);
+                    mScaled++;
+                }
+                break;
+        }
+        LOG(DEBUG) << "BoostGovernor: " << hint << " -> "
+                   << (issued.empty() ? "dropped" : issued);
+    }
+    if (held) {
+        std::lock_guard<std::mutex> guard(mHeldLock);
+        // A racing Begin() may have decided first; issue what it recorded.
+        return mHeld.emplace(hint, issued).first->second;
+    }
+    return issued;
+}
+
+std::string BoostGovernor::End(const std::string &hint) {
+    std::lock_guard<std::mutex> guard(mHeldLock);
+    auto it = mHeld.find(hint);
+    if (it == mHeld.end()) {
+        return hint;
+    }
+    std::string issued = std::move(it->second);
+    mHeld.erase(it);
+    return issued;
+}
+
+void BoostGovernor::DumpToFd(int fd) {
+    std::string buf(::android::base::StringPrintf(
+            "Boost governor: temp=%d battery=%d policies=%zu dropped=%" PRIu64
+            " replaced=%" PRIu64 " scaled=%" PRIu64 "\n",
+            mTemp.load(), mBattery.load(), mPolicies.size(), mDropped.load(), mReplaced.load(),
+            mScaled.load()));
+    {
+        std::lock_guard<std::mutex> guard(mHeldLock);
+        for (const auto &held : mHeld) {
+            if (held.first == held.second) {
+                continue;
+            }
+            ::android::base::StringAppendF(&buf, "  %s -> %s\n", held.first.c_str(),
+                                           held.second.empty() ? "dropped" : held.second.c_str());
+        }
+    }
+    if (!::android::base::WriteStringToFd(buf, fd)) {
+        PLOG(ERROR) << "Failed to dump boost governor to fd";
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <json/json.h>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// Drops, replaces or shortens PowerExt hints and the ADPF escalation hint
+// while the device is hot or the battery is low. Readings come from sysfs,
+// cached for PollIntervalMs, and the policies from the "BoostGovernor"
+// section of powerhint.json:
+//
+//   "BoostGovernor": {
+//       "ThermalPath": "/sys/class/thermal/thermal_zone0/temp",
+//       "BatteryPath": "/sys/class/power_supply/battery/capacity",
+//       "PollIntervalMs": 5000,
+//       "Policies": [
+//           { "Hints": ["*"], "MinTemp": 75000, "Action": "Drop" },
+//           { "Hints": ["LAUNCH"], "MinTemp": 60000, "Action": "Scale", "DurationScale": 0.5 },
+//           { "Hints": ["X"], "MaxBattery": 15, "Action": "Replace", "Replacement": "X_LOW" }
+//       ]
+//   }
+//
+// The first policy whose conditions all hold wins. The readings can be
+// overridden with vendor.powerhal.governor.fake_temp and fake_battery.
+class BoostGovernor {
+  public:
+    // Returns a governor without policies if the section is missing.
+    static std::unique_ptr<BoostGovernor> GetFromJSON(const std::string &config_path);
+    // Returns the hint to issue for |hint|, or an empty string to drop it.
+    // |durationMs| may be shortened; pass nullptr for modes. Hints held
+    // until ended (modes, zero duration boosts) are remembered for End(), and
+    // beginning them again before that returns the same hint.
+    std::string Begin(const std::string &hint, int32_t *durationMs);
+    // Returns the hint Begin() issued for |hint|, empty if it was dropped.
+    std::string End(const std::string &hint);
+    void DumpToFd(int fd);
+
+  private:
+    enum class Action { DROP, REPLACE, SCALE };
+    struct Policy {
+        std::vector<std::string> hints;
+        int minTemp;     // INT_MIN if unset
+        int maxBattery;  // INT_MAX if unset
+        Action action;
+        std::string replacement;
+        double durationScale;
+    };
+    BoostGovernor();
+    const Policy *Match(const std::string &hint);
+    void Refresh();
+    std::string mThermalPath;
+    std::string mBatteryPath;
+    int64_t mPollIntervalNs;
+    std::vector<Policy> mPolicies;
+    // Latest readings, INT_MIN when unreadable.
+    std::atomic<int> mTemp;
+    std::atomic<int> mBattery;
+    std::atomic<int64_t> mLastPollNs;
+    std::mutex mPollLock;
+    std::mutex mHeldLock;
+    std::unordered_map<std::string, std::string> mHeld;  // protected by mHeldLock
+    std::atomic<uint64_t> mDropped;
+    std::atomic<uint64_t> mReplaced;
+    std::atomic<uint64_t> mScaled;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
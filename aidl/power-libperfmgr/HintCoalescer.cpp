@@ -0,0 +1,110 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include "HintCoalescer.h"
+
+#include <inttypes.h>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <utils/Log.h>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+bool HintCoalescer::DoHint(const std::string &hint) {
+    std::lock_guard<std::mutex> guard(mLock);
+    HintState &state = mHints[hint];
+    if (state.held) {
+        state.suppressed++;
+        mSuppressed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    state.issued++;
+    mIssued.fetch_add(1, std::memory_order_relaxed);
+    const bool ret = mHintManager->DoHint(hint);
+    state.held = ret;
+    return ret;
+}
+
+bool HintCoalescer::DoHint(const std::string &hint, std::chrono::milliseconds timeout) {
+    const Clock::time_point expiry = Clock::now() + timeout;
+    std::lock_guard<std::mutex> guard(mLock);
+    HintState &state = mHints[hint];
+    if (state.held || expiry <= state.expiry) {
+        state.suppressed++;
+        mSuppressed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    state.issued++;
+    mIssued.fetch_add(1, std::memory_order_relaxed);
+    const bool ret = mHintManager->DoHint(hint, timeout);
+    if (ret) {
+        state.expiry = expiry;
+    }
+    return ret;
+}
+
+bool HintCoalescer::EndHint(const std::string &hint) {
+    std::lock_guard<std::mutex> guard(mLock);
+    HintState &state = mHints[hint];
+    if (!state.held && state.expiry <= Clock::now() && state.issued > 0) {
+        // Ended or expired already.
+        state.suppressed++;
+        mSuppressed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    // Hints never requested through us are passed through, in case they
+    // were requested directly on the HintManager.
+    state.issued++;
+    mIssued.fetch_add(1, std::memory_order_relaxed);
+    state.held = false;
+    state.expiry = Clock::time_point();
+    return mHintManager->EndHint(hint);
+}
+
+void HintCoalescer::DumpToFd(int fd) {
+    std::string buf(::android::base::StringPrintf(
+            "Hint requests issued: %" PRIu64 ", suppressed: %" PRIu64 "\n",
+            mIssued.load(std::memory_order_relaxed), mSuppressed.load(std::memory_order_relaxed)));
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        for (const auto &[hint, state] : mHints) {
+            if (state.suppressed == 0) {
+                continue;
+            }
+            ::android::base::StringAppendF(&buf, "  %s: issued %" PRIu64 ", suppressed %" PRIu64
+                                           "\n",
+                                           hint.c_str(), state.issued, state.suppressed);
+        }
+    }
+    if (!::android::base::WriteStringToFd(buf, fd)) {
+        ALOGE("Failed to dump hint coalescing to fd");
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
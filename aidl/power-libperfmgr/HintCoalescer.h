@@ -0,0 +1,71 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <perfmgr/HintManager.h>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::perfmgr::HintManager;
+
+// Drops DoHint/EndHint requests that cannot change what libperfmgr writes:
+// a DoHint whose timeout is already covered by an earlier request of the
+// same hint, and an EndHint of a hint that is not held. libperfmgr itself
+// skips node writes whose value is unchanged and applies requests arriving
+// together in one pass of its looper; this saves the request round trip.
+class HintCoalescer {
+  public:
+    explicit HintCoalescer(std::shared_ptr<HintManager> hint_manager)
+        : mHintManager(std::move(hint_manager)) {}
+    bool DoHint(const std::string &hint);
+    bool DoHint(const std::string &hint, std::chrono::milliseconds timeout);
+    bool EndHint(const std::string &hint);
+    void DumpToFd(int fd);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    struct HintState {
+        bool held = false;  // untimed request
+        Clock::time_point expiry;
+        uint64_t issued = 0;
+        uint64_t suppressed = 0;
+    };
+    const std::shared_ptr<HintManager> mHintManager;
+    std::mutex mLock;
+    std::unordered_map<std::string, HintState> mHints;  // protected by mLock
+    std::atomic<uint64_t> mIssued{0};
+    std::atomic<uint64_t> mSuppressed{0};
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
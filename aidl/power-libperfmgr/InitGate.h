@@ -0,0 +1,97 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// Lets the service take binder calls while the config is still being loaded
+// on the init worker. Calls that change state are queued and replayed in
+// order by Open(); everything else is answered with a safe default or waits.
+class InitGate {
+  public:
+    InitGate() : mReady(false) {}
+
+    bool IsReady() const { return mReady.load(std::memory_order_acquire); }
+
+    // Queues |fn| and returns true if the gate is still closed. Returns false
+    // without touching |fn| once it is open, the caller then proceeds.
+    template <typename F>
+    bool Defer(F &&fn) {
+        if (IsReady()) {
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(mLock);
+        if (mReady.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        mPending.emplace_back(std::forward<F>(fn));
+        return true;
+    }
+
+    // Replays queued calls, then opens the gate. Calls queued while replaying
+    // are drained too, so the original order is kept.
+    void Open() {
+        while (true) {
+            std::vector<std::function<void()>> pending;
+            {
+                std::lock_guard<std::mutex> guard(mLock);
+                if (mPending.empty()) {
+                    mReady.store(true, std::memory_order_release);
+                    break;
+                }
+                pending.swap(mPending);
+            }
+            for (auto &fn : pending) {
+                fn();
+            }
+        }
+        mCv.notify_all();
+    }
+
+    bool WaitReady(std::chrono::milliseconds timeout) {
+        if (IsReady()) {
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(mLock);
+        return mCv.wait_for(lock, timeout, [this] { return IsReady(); });
+    }
+
+  private:
+    std::atomic<bool> mReady;
+    std::mutex mLock;
+    std::condition_variable mCv;
+    std::vector<std::function<void()>> mPending;  // protected by mLock
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
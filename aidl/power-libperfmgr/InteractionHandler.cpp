@@ -17,16 +17,21 @@
 #define LOG_TAG "powerhal-libperfmgr"
 #define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
 
+#include <algorithm>
 #include <array>
 #include <memory>
 
 #include <fcntl.h>
-#include <poll.h>
+#include <inttypes.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <android-base/file.h>
 #include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 
@@ -34,8 +39,9 @@
 
 #define MAX_LENGTH 64
 
-#define MSINSEC 1000L
-#define NSINMS 1000000L
+#define NSINSEC 1000000000LL
+#define NSINMS 1000000LL
+#define NSINUS 1000LL
 
 namespace aidl {
 namespace google {
@@ -58,12 +64,15 @@ static const uint32_t kMaxDurationMs =
         ::android::base::GetUintProperty("vendor.powerhal.interaction.max", /*default*/ 5650U);
 static const uint32_t kDurationOffsetMs =
         ::android::base::GetUintProperty("vendor.powerhal.interaction.offset", /*default*/ 650U);
-
-static size_t CalcTimespecDiffMs(struct timespec start, struct timespec end) {
-    size_t diff_in_ms = 0;
-    diff_in_ms += (end.tv_sec - start.tv_sec) * MSINSEC;
-    diff_in_ms += (end.tv_nsec - start.tv_nsec) / NSINMS;
-    return diff_in_ms;
+static const bool kAdaptiveDuration =
+        ::android::base::GetBoolProperty("vendor.powerhal.interaction.adaptive", true);
+static const uint32_t kAdaptiveMinSamples = ::android::base::GetUintProperty(
+        "vendor.powerhal.interaction.adaptive.min_samples", /*default*/ 16U);
+
+static int64_t NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSINSEC + ts.tv_nsec;
 }
 
 static int FbIdleOpen(void) {
@@ -77,11 +86,42 @@ static int FbIdleOpen(void) {
     return -1;
 }
 
+// Reading the node also re-arms it for the next sysfs_notify().
+static bool FbIdleRead(int fd, bool *idle) {
+    char data[MAX_LENGTH];
+    ssize_t ret = pread(fd, data, sizeof(data), 0);
+    if (ret <= 0) {
+        ALOGE("%s: Unexpected EOF or error (%zd)!", __func__, ret);
+        return false;
+    }
+    *idle = !strncmp(data, "idle", 4);
+    return true;
+}
+
 }  // namespace
 
 InteractionHandler::InteractionHandler(std::shared_ptr<HintManager> const &hint_manager)
     : mState(INTERACTION_STATE_UNINITIALIZED),
-      mDurationMs(0),
+      mIdleFd(-1),
+      mEventFd(-1),
+      mTimerFd(-1),
+      mEpollFd(-1),
+      mBoostEndNs(0),
+      mBoostActive(false),
+      mExiting(false),
+      mBoostStartNs(0),
+      mIdleSamplesMs{},
+      mIdleSampleCount(0),
+      mLearnedDurationMs(0),
+      mIdleLatencyEwmaMs(0),
+      mAcquireArrivalNs(0),
+      mPerfLockNs(0),
+      mAcquireCount(0),
+      mCoalescedCount(0),
+      mExtendCount(0),
+      mFallbackCount(0),
+      mIdleReleaseCount(0),
+      mTimeoutReleaseCount(0),
       mHintManager(hint_manager) {}
 
 InteractionHandler::~InteractionHandler() {
@@ -99,31 +139,60 @@ bool InteractionHandler::Init() {
         return false;
     mIdleFd = fd;
 
-    mEventFd = eventfd(0, EFD_NONBLOCK);
-    if (mEventFd < 0) {
-        ALOGE("Unable to create event fd (%d)", errno);
-        close(mIdleFd);
-        return false;
+    mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEventFd < 0 || mTimerFd < 0 || mEpollFd < 0) {
+        ALOGE("Unable to create event/timer/epoll fd (%d)", errno);
+        goto error;
+    }
+
+    {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = mEventFd;
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &ev) < 0)
+            goto error;
+        ev.data.fd = mTimerFd;
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mTimerFd, &ev) < 0)
+            goto error;
+        ev.events = EPOLLPRI | EPOLLERR;
+        ev.data.fd = mIdleFd;
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mIdleFd, &ev) < 0)
+            goto error;
     }
 
+    mExiting = false;
     mState = INTERACTION_STATE_IDLE;
     mThread = std::unique_ptr<std::thread>(new std::thread(&InteractionHandler::Routine, this));
 
     return true;
+
+error:
+    ALOGE("Unable to set up interaction event loop (%d)", errno);
+    for (int *pfd : {&mEpollFd, &mTimerFd, &mEventFd, &mIdleFd}) {
+        if (*pfd >= 0) {
+            close(*pfd);
+            *pfd = -1;
+        }
+    }
+    return false;
 }
 
 void InteractionHandler::Exit() {
-    std::unique_lock<std::mutex> lk(mLock);
+    std::lock_guard<std::mutex> lk(mLock);
     if (mState == INTERACTION_STATE_UNINITIALIZED)
         return;
 
-    AbortWaitLocked();
-    mState = INTERACTION_STATE_UNINITIALIZED;
-    lk.unlock();
-
-    mCond.notify_all();
+    mExiting = true;
+    uint64_t val = 1;
+    ssize_t ret = write(mEventFd, &val, sizeof(val));
+    ALOGW_IF(ret != sizeof(val), "Unable to write to event fd (%zd)", ret);
     mThread->join();
+    mState = INTERACTION_STATE_UNINITIALIZED;
 
+    close(mEpollFd);
+    close(mTimerFd);
     close(mEventFd);
     close(mIdleFd);
 }
@@ -144,134 +213,229 @@ void InteractionHandler::PerfRel() {
 
 void InteractionHandler::Acquire(int32_t duration) {
     ATRACE_CALL();
-
-    std::lock_guard<std::mutex> lk(mLock);
+    const int64_t arrival = NowNs();
+    mAcquireCount.fetch_add(1, std::memory_order_relaxed);
+
+    // Once enough interactions were seen, the floor follows how long the
+    // display actually takes to go idle instead of the fixed minimum.
+    int minDuration = kMinDurationMs;
+    if (kAdaptiveDuration) {
+        const int learned = mLearnedDurationMs.load(std::memory_order_relaxed);
+        if (learned > 0)
+            minDuration = learned;
+    }
 
     int inputDuration = duration + kDurationOffsetMs;
     int finalDuration;
     if (inputDuration > kMaxDurationMs)
         finalDuration = kMaxDurationMs;
-    else if (inputDuration > kMinDurationMs)
+    else if (inputDuration > minDuration)
         finalDuration = inputDuration;
     else
-        finalDuration = kMinDurationMs;
+        finalDuration = minDuration;
 
     // Fallback to do boost directly
     // 1) override property is set OR
     // 2) InteractionHandler not initialized
     if (!kDisplayIdleSupport || mState == INTERACTION_STATE_UNINITIALIZED) {
+        mFallbackCount.fetch_add(1, std::memory_order_relaxed);
         mHintManager->DoHint("INTERACTION", std::chrono::milliseconds(finalDuration));
         return;
     }
 
-    struct timespec cur_timespec;
-    clock_gettime(CLOCK_MONOTONIC, &cur_timespec);
-    if (mState != INTERACTION_STATE_IDLE && finalDuration <= mDurationMs) {
-        size_t elapsed_time = CalcTimespecDiffMs(mLastTimespec, cur_timespec);
-        // don't hint if previous hint's duration covers this hint's duration
-        if (elapsed_time <= (mDurationMs - finalDuration)) {
-            ALOGV("%s: Previous duration (%d) cover this (%d) elapsed: %lld", __func__,
-                  static_cast<int>(mDurationMs), static_cast<int>(finalDuration),
-                  static_cast<long long>(elapsed_time));
-            return;
+    const int64_t end = arrival + finalDuration * NSINMS;
+    int64_t cur = mBoostEndNs.load();
+    // don't hint if previous hint's duration covers this hint's duration
+    if (mBoostActive && end <= cur) {
+        ALOGV("%s: Previous boost until %lld covers this (%d)", __func__,
+              static_cast<long long>(cur), finalDuration);
+        const uint64_t coalesced = mCoalescedCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (ATRACE_ENABLED()) {
+            ATRACE_INT("interaction.coalesced", coalesced);
         }
+        return;
     }
-    mLastTimespec = cur_timespec;
-    mDurationMs = finalDuration;
+    while (end > cur && !mBoostEndNs.compare_exchange_weak(cur, end)) {
+    }
+    int64_t unserved = 0;
+    mAcquireArrivalNs.compare_exchange_strong(unserved, arrival);
 
     ALOGV("%s: input: %d final duration: %d", __func__, duration, finalDuration);
 
-    if (mState == INTERACTION_STATE_WAITING)
-        AbortWaitLocked();
-    else if (mState == INTERACTION_STATE_IDLE)
-        PerfLock();
+    uint64_t val = 1;
+    ssize_t ret = write(mEventFd, &val, sizeof(val));
+    ALOGW_IF(ret != sizeof(val), "Unable to write to event fd (%zd)", ret);
+}
 
-    mState = INTERACTION_STATE_INTERACTION;
-    mCond.notify_one();
+void InteractionHandler::ArmTimer(int64_t deadline_ns) {
+    struct itimerspec spec = {};
+    if (deadline_ns > 0) {
+        spec.it_value.tv_sec = deadline_ns / NSINSEC;
+        spec.it_value.tv_nsec = deadline_ns % NSINSEC;
+    }
+    if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+        ALOGE("%s: failed to arm timer (%d)", __func__, errno);
+    }
 }
 
-void InteractionHandler::Release() {
-    std::lock_guard<std::mutex> lk(mLock);
-    if (mState == INTERACTION_STATE_WAITING) {
+void InteractionHandler::HandleAcquire() {
+    const int64_t arrival = mAcquireArrivalNs.exchange(0);
+    if (mState == INTERACTION_STATE_IDLE) {
         ATRACE_CALL();
-        PerfRel();
-        mState = INTERACTION_STATE_IDLE;
+        PerfLock();
+        mBoostActive = true;
+        mPerfLockNs = NowNs();
+        if (arrival > 0) {
+            const int64_t latency_us = (mPerfLockNs - arrival) / NSINUS;
+            mAcquireLatencyUs.record(latency_us);
+            if (ATRACE_ENABLED()) {
+                ATRACE_INT("interaction.acquire_latency_us", latency_us);
+            }
+        }
     } else {
-        // clear any wait aborts pending in event fd
-        uint64_t val;
-        ssize_t ret = read(mEventFd, &val, sizeof(val));
-
-        ALOGW_IF(ret < 0, "%s: failed to clear eventfd (%zd, %d)", __func__, ret, errno);
+        mExtendCount.fetch_add(1, std::memory_order_relaxed);
     }
+    // New or extended boost: give the display kWaitMs before watching for
+    // idle again. This is a single timer rearm.
+    const int64_t now = NowNs();
+    mBoostStartNs = now;
+    mState = INTERACTION_STATE_INTERACTION;
+    ArmTimer(now + kWaitMs * NSINMS);
 }
 
-// should be called while locked
-void InteractionHandler::AbortWaitLocked() {
-    uint64_t val = 1;
-    ssize_t ret = write(mEventFd, &val, sizeof(val));
-    if (ret != sizeof(val))
-        ALOGW("Unable to write to event fd (%zd)", ret);
-}
-
-void InteractionHandler::WaitForIdle(int32_t wait_ms, int32_t timeout_ms) {
-    char data[MAX_LENGTH];
-    ssize_t ret;
-    struct pollfd pfd[2];
-
-    ATRACE_CALL();
-
-    ALOGV("%s: wait:%d timeout:%d", __func__, wait_ms, timeout_ms);
-
-    pfd[0].fd = mEventFd;
-    pfd[0].events = POLLIN;
-    pfd[1].fd = mIdleFd;
-    pfd[1].events = POLLPRI | POLLERR;
-
-    ret = poll(pfd, 1, wait_ms);
-    if (ret > 0) {
-        ALOGV("%s: wait aborted", __func__);
-        return;
-    } else if (ret < 0) {
-        ALOGE("%s: error in poll while waiting", __func__);
+void InteractionHandler::HandleTimer() {
+    uint64_t expirations;
+    ssize_t ret = read(mTimerFd, &expirations, sizeof(expirations));
+    if (ret != sizeof(expirations)) {
+        // Rearmed after expiring, nothing to do.
         return;
     }
 
-    ret = pread(mIdleFd, data, sizeof(data), 0);
-    if (!ret) {
-        ALOGE("%s: Unexpected EOF!", __func__);
+    if (mState == INTERACTION_STATE_WAITING) {
+        ALOGV("%s: timed out waiting for idle", __func__);
+        // Not an idle latency sample: it only measures the current floor plus
+        // kWaitMs, and with continuous animation it would ratchet the learned
+        // floor up to kMaxDurationMs. Timeouts are counted by Release().
+        Release(true);
+        return;
+    }
+    if (mState != INTERACTION_STATE_INTERACTION) {
         return;
     }
 
-    if (!strncmp(data, "idle", 4)) {
+    bool idle = false;
+    if (!FbIdleRead(mIdleFd, &idle) || idle) {
         ALOGV("%s: already idle", __func__);
+        RecordIdleLatency(NowNs());
+        Release(false);
         return;
     }
+    mState = INTERACTION_STATE_WAITING;
+    ArmTimer(std::max(mBoostEndNs.load() + kWaitMs * NSINMS, NowNs() + NSINMS));
+}
 
-    ret = poll(pfd, 2, timeout_ms);
-    if (ret < 0)
-        ALOGE("%s: Error on waiting for idle (%zd)", __func__, ret);
-    else if (ret == 0)
-        ALOGV("%s: timed out waiting for idle", __func__);
-    else if (pfd[0].revents)
-        ALOGV("%s: wait for idle aborted", __func__);
-    else if (pfd[1].revents)
+void InteractionHandler::HandleIdleEdge() {
+    bool idle = false;
+    if (!FbIdleRead(mIdleFd, &idle)) {
+        return;
+    }
+    if (mState == INTERACTION_STATE_WAITING && idle) {
         ALOGV("%s: idle detected", __func__);
+        RecordIdleLatency(NowNs());
+        Release(false);
+    }
+}
+
+void InteractionHandler::RecordIdleLatency(int64_t now_ns) {
+    const int32_t latency_ms = static_cast<int32_t>((now_ns - mBoostStartNs) / NSINMS);
+    mIdleLatencyMs.record(latency_ms);
+    const int32_t ewma = mIdleLatencyEwmaMs.load(std::memory_order_relaxed);
+    mIdleLatencyEwmaMs.store(ewma == 0 ? latency_ms : (ewma * 7 + latency_ms) / 8,
+                             std::memory_order_relaxed);
+
+    mIdleSamplesMs[mIdleSampleCount % kIdleSampleWindow] = latency_ms;
+    mIdleSampleCount++;
+    if (!kAdaptiveDuration || mIdleSampleCount < kAdaptiveMinSamples)
+        return;
+
+    // P90 of the recent window plus some headroom.
+    std::array<int32_t, kIdleSampleWindow> window = mIdleSamplesMs;
+    const size_t n = std::min(mIdleSampleCount, kIdleSampleWindow);
+    auto p90 = window.begin() + (n * 9) / 10;
+    std::nth_element(window.begin(), p90, window.begin() + n);
+    const int32_t learned = std::clamp<int32_t>(*p90 + *p90 / 4, kWaitMs, kMaxDurationMs);
+    mLearnedDurationMs.store(learned, std::memory_order_relaxed);
+}
+
+void InteractionHandler::DumpToFd(int fd) {
+    std::string buf(::android::base::StringPrintf(
+            "Interaction boost: active: %d, learned min duration: %d ms (fixed %u ms), "
+            "idle latency ewma: %d ms\n",
+            mBoostActive.load(), mLearnedDurationMs.load(), kMinDurationMs,
+            mIdleLatencyEwmaMs.load()));
+    const uint64_t idle = mIdleReleaseCount.load();
+    const uint64_t timeouts = mTimeoutReleaseCount.load();
+    ::android::base::StringAppendF(
+            &buf,
+            "Interaction acquires: %" PRIu64 ", coalesced: %" PRIu64 ", extended: %" PRIu64
+            ", direct: %" PRIu64 "\n"
+            "Interaction releases: idle %" PRIu64 ", timeout %" PRIu64 " (%" PRIu64 "%% idle)\n",
+            mAcquireCount.load(), mCoalescedCount.load(), mExtendCount.load(),
+            mFallbackCount.load(), idle, timeouts,
+            idle + timeouts ? idle * 100 / (idle + timeouts) : 0);
+    mAcquireLatencyUs.dump(&buf, "Interaction acquire to PerfLock", "us");
+    mBoostHoldMs.dump(&buf, "Interaction boost hold", "ms");
+    mIdleLatencyMs.dump(&buf, "Interaction idle latency", "ms");
+    if (!::android::base::WriteStringToFd(buf, fd)) {
+        ALOGE("Failed to dump interaction state to fd");
+    }
+}
+
+void InteractionHandler::Release(bool timed_out) {
+    ATRACE_CALL();
+    PerfRel();
+    const int64_t hold_ms = (NowNs() - mPerfLockNs) / NSINMS;
+    mBoostHoldMs.record(hold_ms);
+    auto &releases = timed_out ? mTimeoutReleaseCount : mIdleReleaseCount;
+    const uint64_t count = releases.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (ATRACE_ENABLED()) {
+        ATRACE_INT("interaction.hold_ms", hold_ms);
+        ATRACE_INT(timed_out ? "interaction.timeouts" : "interaction.idle_releases", count);
+    }
+    mBoostActive = false;
+    mState = INTERACTION_STATE_IDLE;
+    ArmTimer(0);
 }
 
 void InteractionHandler::Routine() {
     pthread_setname_np(pthread_self(), "DispIdle");
-    std::unique_lock<std::mutex> lk(mLock, std::defer_lock);
+    struct epoll_event events[3];
 
     while (true) {
-        lk.lock();
-        mCond.wait(lk, [&] { return mState != INTERACTION_STATE_IDLE; });
-        if (mState == INTERACTION_STATE_UNINITIALIZED)
-            return;
-        mState = INTERACTION_STATE_WAITING;
-        lk.unlock();
-
-        WaitForIdle(kWaitMs, mDurationMs);
-        Release();
+        int n = epoll_wait(mEpollFd, events, 3, -1);
+        if (n < 0) {
+            if (errno != EINTR)
+                ALOGE("%s: epoll_wait failed (%d)", __func__, errno);
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            const int fd = events[i].data.fd;
+            if (fd == mEventFd) {
+                uint64_t val;
+                ssize_t ret = read(mEventFd, &val, sizeof(val));
+                ALOGW_IF(ret < 0, "%s: failed to clear eventfd (%zd, %d)", __func__, ret, errno);
+                if (mExiting) {
+                    if (mBoostActive)
+                        PerfRel();
+                    return;
+                }
+                HandleAcquire();
+            } else if (fd == mTimerFd) {
+                HandleTimer();
+            } else if (fd == mIdleFd) {
+                HandleIdleEdge();
+            }
+        }
     }
 }
 
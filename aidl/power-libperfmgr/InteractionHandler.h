@@ -16,7 +16,8 @@
 
 #pragma once
 
-#include <condition_variable>
+#include <array>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -24,6 +25,8 @@
 
 #include <perfmgr/HintManager.h>
 
+#include "LatencyHistogram.h"
+
 namespace aidl {
 namespace google {
 namespace hardware {
@@ -40,6 +43,10 @@ enum InteractionState {
     INTERACTION_STATE_WAITING,
 };
 
+// Holds the INTERACTION hint until the display goes idle or the boost times
+// out. Acquire() only publishes the new boost deadline and wakes the worker;
+// the state machine runs on a single epoll loop over an eventfd (acquire and
+// exit), a timerfd (idle check and timeout) and the display idle node.
 class InteractionHandler {
   public:
     InteractionHandler(std::shared_ptr<HintManager> const &hint_manager);
@@ -47,24 +54,53 @@ class InteractionHandler {
     bool Init();
     void Exit();
     void Acquire(int32_t duration);
+    void DumpToFd(int fd);
 
   private:
-    void Release();
-    void WaitForIdle(int32_t wait_ms, int32_t timeout_ms);
-    void AbortWaitLocked();
     void Routine();
+    void HandleAcquire();
+    void HandleTimer();
+    void HandleIdleEdge();
+    void Release(bool timed_out);
+    void ArmTimer(int64_t deadline_ns);
+    void RecordIdleLatency(int64_t now_ns);
 
     void PerfLock();
     void PerfRel();
 
-    enum InteractionState mState;
+    // Written by Init/Exit, otherwise owned by the worker thread.
+    std::atomic<InteractionState> mState;
     int mIdleFd;
     int mEventFd;
-    int32_t mDurationMs;
-    struct timespec mLastTimespec;
+    int mTimerFd;
+    int mEpollFd;
+    // CLOCK_MONOTONIC time the latest boost request lasts until.
+    std::atomic<int64_t> mBoostEndNs;
+    // Whether the worker currently holds the INTERACTION hint.
+    std::atomic<bool> mBoostActive;
+    std::atomic<bool> mExiting;
+    // Adaptive duration state. The sample window is owned by the worker.
+    static constexpr size_t kIdleSampleWindow = 64;
+    int64_t mBoostStartNs;
+    std::array<int32_t, kIdleSampleWindow> mIdleSamplesMs;
+    size_t mIdleSampleCount;
+    // Boost duration floor learned from the idle latency, 0 until learned.
+    std::atomic<int32_t> mLearnedDurationMs;
+    std::atomic<int32_t> mIdleLatencyEwmaMs;
+    LatencyHistogram mIdleLatencyMs;
+    // Instrumentation, see DumpToFd().
+    std::atomic<int64_t> mAcquireArrivalNs;  // oldest unserved Acquire, 0 if none
+    int64_t mPerfLockNs;                     // owned by the worker
+    std::atomic<uint64_t> mAcquireCount;
+    std::atomic<uint64_t> mCoalescedCount;
+    std::atomic<uint64_t> mExtendCount;
+    std::atomic<uint64_t> mFallbackCount;
+    std::atomic<uint64_t> mIdleReleaseCount;
+    std::atomic<uint64_t> mTimeoutReleaseCount;
+    LatencyHistogram mAcquireLatencyUs;
+    LatencyHistogram mBoostHoldMs;
     std::unique_ptr<std::thread> mThread;
     std::mutex mLock;
-    std::condition_variable mCond;
     std::shared_ptr<HintManager> mHintManager;
 };
 
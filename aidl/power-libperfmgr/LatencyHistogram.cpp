@@ -0,0 +1,107 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyHistogram.h"
+
+#include <android-base/stringprintf.h>
+
+#include <inttypes.h>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::base::StringAppendF;
+
+namespace {
+
+static size_t bucketOf(int64_t value) {
+    if (value < 2) {
+        return 0;
+    }
+    const size_t bucket = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+    return bucket < LatencyHistogram::kBucketCount ? bucket : LatencyHistogram::kBucketCount - 1;
+}
+
+static int64_t bucketLow(size_t bucket) {
+    return bucket == 0 ? 0 : int64_t{1} << bucket;
+}
+
+static int64_t bucketHigh(size_t bucket) {
+    return int64_t{1} << (bucket + 1);
+}
+
+}  // namespace
+
+void LatencyHistogram::record(int64_t value) {
+    if (value < 0) {
+        value = 0;
+    }
+    mBuckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(value, std::memory_order_relaxed);
+    int64_t max = mMax.load(std::memory_order_relaxed);
+    while (value > max && !mMax.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+    mCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::percentile(int pct) const {
+    uint64_t total = 0;
+    std::array<uint64_t, kBucketCount> counts;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        counts[i] = mBuckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const uint64_t rank = (total * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        seen += counts[i];
+        if (seen >= rank && counts[i] > 0) {
+            return bucketHigh(i);
+        }
+    }
+    return bucketHigh(kBucketCount - 1);
+}
+
+void LatencyHistogram::dump(std::string *out, const char *name, const char *unit) const {
+    const uint64_t n = count();
+    StringAppendF(out,
+                  "%s: count %" PRIu64 ", mean %" PRId64 " %s, p50/p90/p99 <%" PRId64 "/<%" PRId64
+                  "/<%" PRId64 " %s, max %" PRId64 " %s\n",
+                  name, n, n ? mSum.load(std::memory_order_relaxed) / static_cast<int64_t>(n) : 0,
+                  unit, percentile(50), percentile(90), percentile(99), unit,
+                  mMax.load(std::memory_order_relaxed), unit);
+    for (size_t i = 0; i < kBucketCount; i++) {
+        const uint64_t c = mBuckets[i].load(std::memory_order_relaxed);
+        if (c > 0) {
+            StringAppendF(out, "  [%" PRId64 ", %" PRId64 ") %s: %" PRIu64 "\n", bucketLow(i),
+                          bucketHigh(i), unit, c);
+        }
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
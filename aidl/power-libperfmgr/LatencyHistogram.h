@@ -0,0 +1,55 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// Lock-free histogram with power-of-two buckets. Bucket 0 holds [0, 2) and
+// bucket i holds [2^i, 2^(i+1)); the unit is up to the caller.
+class LatencyHistogram {
+  public:
+    static constexpr size_t kBucketCount = 32;
+    void record(int64_t value);
+    uint64_t count() const { return mCount.load(std::memory_order_relaxed); }
+    // Upper bound of the bucket holding the |pct|-th percentile.
+    int64_t percentile(int pct) const;
+    // Appends a one-line summary and the non-empty buckets.
+    void dump(std::string *out, const char *name, const char *unit) const;
+
+  private:
+    std::array<std::atomic<uint64_t>, kBucketCount> mBuckets{};
+    std::atomic<uint64_t> mCount{0};
+    std::atomic<int64_t> mSum{0};
+    std::atomic<int64_t> mMax{0};
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include "ModeComposer.h"
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+static bool Contains(const std::vector<std::string> &names, const std::string &name) {
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+static std::vector<std::string> ParseNames(const Json::Value &names) {
+    std::vector<std::string> out;
+    if (!names.isArray()) {
+        return out;
+    }
+    for (Json::ArrayIndex i = 0; i < names.size(); i++) {
+        if (names[i].isString()) {
+            out.push_back(names[i].asString());
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+std::unique_ptr<ModeComposer> ModeComposer::GetFromJSON(
+        const std::string &config_path, std::shared_ptr<HintManager> hint_manager) {
+    std::unique_ptr<ModeComposer> composer(new ModeComposer(std::move(hint_manager)));
+    std::string json_doc;
+    if (!::android::base::ReadFileToString(config_path, &json_doc)) {
+        LOG(ERROR) << "Failed to read JSON config from " << config_path;
+        return composer;
+    }
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(json_doc, root)) {
+        LOG(ERROR) << "Failed to parse JSON config: " << reader.getFormattedErrorMessages();
+        return composer;
+    }
+    const Json::Value &section = root["ModeComposition"];
+    if (!section.isObject()) {
+        LOG(WARNING) << "No ModeComposition in " << config_path;
+        return composer;
+    }
+
+    const Json::Value &compositions = section["Compositions"];
+    for (Json::ArrayIndex i = 0; compositions.isArray() && i < compositions.size(); i++) {
+        const uint32_t mask = composer->ParseModes(compositions[i]["Modes"]);
+        const std::string hint = compositions[i]["Hint"].asString();
+        if (mask == 0 || hint.empty()) {
+            LOG(ERROR) << "Invalid composition[" << i << "]";
+            continue;
+        }
+        composer->mCompositions.push_back({mask, hint});
+    }
+
+    const Json::Value &suppressions = section["Suppressions"];
+    for (Json::ArrayIndex i = 0; suppressions.isArray() && i < suppressions.size(); i++) {
+        // Suppressions are keyed on composed modes only.
+        uint32_t mask = 0;
+        for (const auto &mode : ParseNames(suppressions[i]["WhenAny"])) {
+            const int index = composer->ModeIndex(mode);
+            if (index < 0) {
+                LOG(ERROR) << "Suppression[" << i << "] refers to unknown mode " << mode;
+                continue;
+            }
+            mask |= 1u << index;
+        }
+        composer->mSuppressions.push_back({mask, ParseNames(suppressions[i]["Modes"]),
+                                           ParseNames(suppressions[i]["Boosts"])});
+    }
+
+    LOG(INFO) << "ModeComposer: " << composer->mModes.size() << " modes, "
+              << composer->mCompositions.size() << " compositions, "
+              << composer->mSuppressions.size() << " suppressions";
+    return composer;
+}
+
+uint32_t ModeComposer::ParseModes(const Json::Value &modes) {
+    uint32_t mask = 0;
+    for (const auto &mode : ParseNames(modes)) {
+        int index = ModeIndex(mode);
+        if (index < 0) {
+            if (mModes.size() >= kMaxModes) {
+                LOG(ERROR) << "Too many composed modes, ignoring " << mode;
+                continue;
+            }
+            index = mModes.size();
+            mModes.push_back(mode);
+        }
+        mask |= 1u << index;
+    }
+    return mask;
+}
+
+int ModeComposer::ModeIndex(const std::string &mode) const {
+    auto it = std::find(mModes.begin(), mModes.end(), mode);
+    return it == mModes.end() ? -1 : static_cast<int>(it - mModes.begin());
+}
+
+bool ModeComposer::IsManaged(const std::string &mode) const {
+    return ModeIndex(mode) >= 0;
+}
+
+std::vector<std::string> ModeComposer::Compose(uint32_t active) const {
+    std::vector<std::string> hints;
+    uint32_t consumed = 0;
+    for (const auto &composition : mCompositions) {
+        if ((composition.mask & active) == composition.mask && !(composition.mask & consumed)) {
+            hints.push_back(composition.hint);
+            consumed |= composition.mask;
+        }
+    }
+    return hints;
+}
+
+void ModeComposer::ApplyLocked(uint32_t active) {
+    std::vector<std::string> hints = Compose(active);
+    // End first so that nodes shared by the old and new hints settle on the
+    // new value.
+    for (const auto &hint : mHeldHints) {
+        if (!Contains(hints, hint)) {
+            mHintManager->EndHint(hint);
+        }
+    }
+    for (const auto &hint : hints) {
+        if (!Contains(mHeldHints, hint)) {
+            mHintManager->DoHint(hint);
+        }
+    }
+    mHeldHints = std::move(hints);
+    mActive.store(active);
+}
+
+void ModeComposer::SetMode(const std::string &mode, bool enabled) {
+    const int index = ModeIndex(mode);
+    if (index < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(mLock);
+    const uint32_t active = mActive.load();
+    const uint32_t next = enabled ? active | (1u << index) : active & ~(1u << index);
+    if (next != active) {
+        ApplyLocked(next);
+    }
+}
+
+bool ModeComposer::RestoreHint(const std::string &hint) {
+    for (const auto &composition : mCompositions) {
+        if (composition.hint == hint) {
+            std::lock_guard<std::mutex> guard(mLock);
+            ApplyLocked(mActive.load() | composition.mask);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ModeComposer::IsSuppressed(const std::string &name, bool boost) const {
+    const uint32_t active = mActive.load(std::memory_order_relaxed);
+    if (active == 0) {
+        return false;
+    }
+    for (const auto &suppression : mSuppressions) {
+        if (!(suppression.whenAny & active)) {
+            continue;
+        }
+        const auto &names = boost ? suppression.boosts : suppression.modes;
+        if (Contains(names, "*") || Contains(names, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ModeComposer::IsModeSuppressed(const std::string &mode) const {
+    return IsSuppressed(mode, false);
+}
+
+bool ModeComposer::IsBoostSuppressed(const std::string &boost) const {
+    return IsSuppressed(boost, true);
+}
+
+void ModeComposer::DumpToFd(int fd) {
+    std::string buf("Composed modes:");
+    std::lock_guard<std::mutex> guard(mLock);
+    const uint32_t active = mActive.load();
+    for (size_t i = 0; i < mModes.size(); i++) {
+        ::android::base::StringAppendF(&buf, " %s=%s", mModes[i].c_str(),
+                                       (active & (1u << i)) ? "on" : "off");
+    }
+    buf.append("\nComposed hints held:");
+    for (const auto &hint : mHeldHints) {
+        buf.append(" ").append(hint);
+    }
+    buf.append("\n");
+    if (!::android::base::WriteStringToFd(buf, fd)) {
+        PLOG(ERROR) << "Failed to dump mode composition to fd";
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+#include <perfmgr/HintManager.h>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::perfmgr::HintManager;
+
+// Maps the set of active composed modes (e.g. SUSTAINED_PERFORMANCE and VR)
+// to the libperfmgr hints to hold, and decides which modes and boosts are
+// suppressed while they are on. Both come from the "ModeComposition"
+// section of powerhint.json:
+//
+//   "ModeComposition": {
+//       "Compositions": [
+//           { "Modes": ["SUSTAINED_PERFORMANCE", "VR"], "Hint": "VR_SUSTAINED_PERFORMANCE" },
+//           ...
+//       ],
+//       "Suppressions": [
+//           { "WhenAny": ["VR"], "Modes": ["LAUNCH"], "Boosts": ["*"] }
+//       ]
+//   }
+//
+// Compositions are listed by priority; the first one whose modes are all
+// active wins and its modes are not reused by later entries.
+class ModeComposer {
+  public:
+    // Returns a composer without compositions if the section is missing, so
+    // that every mode maps to its own hint.
+    static std::unique_ptr<ModeComposer> GetFromJSON(const std::string &config_path,
+                                                     std::shared_ptr<HintManager> hint_manager);
+
+    // Whether |mode| takes part in a composition.
+    bool IsManaged(const std::string &mode) const;
+    // Updates the active set and applies only the hint changes it implies.
+    void SetMode(const std::string &mode, bool enabled);
+    // Activates the modes composed into |hint|, used to restore state.
+    bool RestoreHint(const std::string &hint);
+    // Lock-free checks for the mode and boost paths.
+    bool IsModeSuppressed(const std::string &mode) const;
+    bool IsBoostSuppressed(const std::string &boost) const;
+    void DumpToFd(int fd);
+
+  private:
+    struct Composition {
+        uint32_t mask;
+        std::string hint;
+    };
+    struct Suppression {
+        uint32_t whenAny;
+        std::vector<std::string> modes;
+        std::vector<std::string> boosts;
+    };
+    static constexpr size_t kMaxModes = 32;
+    explicit ModeComposer(std::shared_ptr<HintManager> hint_manager)
+        : mHintManager(std::move(hint_manager)) {}
+    int ModeIndex(const std::string &mode) const;
+    uint32_t ParseModes(const Json::Value &modes);
+    std::vector<std::string> Compose(uint32_t active) const;
+    void ApplyLocked(uint32_t active);
+    bool IsSuppressed(const std::string &name, bool boost) const;
+
+    const std::shared_ptr<HintManager> mHintManager;
+    // Immutable after GetFromJSON().
+    std::vector<std::string> mModes;
+    std::vector<Composition> mCompositions;
+    std::vector<Suppression> mSuppressions;
+    std::mutex mLock;
+    std::vector<std::string> mHeldHints;  // protected by mLock
+    std::atomic<uint32_t> mActive{0};     // written under mLock
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
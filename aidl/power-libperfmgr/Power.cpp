@@ -45,31 +45,30 @@ constexpr char kPowerHalAudioProp[] = "vendor.powerhal.audio";
 constexpr char kPowerHalRenderingProp[] = "vendor.powerhal.rendering";
 constexpr char kPowerHalAdpfRateProp[] = "vendor.powerhal.adpf.rate";
 constexpr int64_t kPowerHalAdpfRateDefault = -1;
+// How long support queries wait for the config before answering unsupported.
+constexpr std::chrono::milliseconds kInitWaitTimeout(5000);
 
-Power::Power(std::shared_ptr<HintManager> hm)
-    : mHintManager(hm),
+Power::Power()
+    : mHintManager(nullptr),
       mInteractionHandler(nullptr),
-      mVRModeOn(false),
-      mSustainedPerfModeOn(false),
+      mModeComposer(nullptr),
+      mHintCoalescer(nullptr),
+      mPowerExt(nullptr),
       mAdpfRateNs(
-              ::android::base::GetIntProperty(kPowerHalAdpfRateProp, kPowerHalAdpfRateDefault)) {
+              ::android::base::GetIntProperty(kPowerHalAdpfRateProp, kPowerHalAdpfRateDefault)) {}
+
+void Power::Init(std::shared_ptr<HintManager> hm, std::shared_ptr<ModeComposer> mc,
+                 std::shared_ptr<HintCoalescer> hc, std::shared_ptr<PowerExt> ext) {
+    mHintManager = std::move(hm);
+    mModeComposer = std::move(mc);
+    mHintCoalescer = std::move(hc);
+    mPowerExt = std::move(ext);
     mInteractionHandler = std::make_unique<InteractionHandler>(mHintManager);
     mInteractionHandler->Init();
 
     std::string state = ::android::base::GetProperty(kPowerHalStateProp, "");
-    if (state == "SUSTAINED_PERFORMANCE") {
-        LOG(INFO) << "Initialize with SUSTAINED_PERFORMANCE on";
-        mHintManager->DoHint("SUSTAINED_PERFORMANCE");
-        mSustainedPerfModeOn = true;
-    } else if (state == "VR") {
-        LOG(INFO) << "Initialize with VR on";
-        mHintManager->DoHint(state);
-        mVRModeOn = true;
-    } else if (state == "VR_SUSTAINED_PERFORMANCE") {
-        LOG(INFO) << "Initialize with SUSTAINED_PERFORMANCE and VR on";
-        mHintManager->DoHint("VR_SUSTAINED_PERFORMANCE");
-        mSustainedPerfModeOn = true;
-        mVRModeOn = true;
+    if (!state.empty() && mModeComposer->RestoreHint(state)) {
+        LOG(INFO) << "Initialize with " << state << " on";
     } else {
         LOG(INFO) << "Initialize PowerHAL";
     }
@@ -87,60 +86,40 @@ Power::Power(std::shared_ptr<HintManager> hm)
     }
 
     // Now start to take powerhint
+    mInitGate.Open();
     LOG(INFO) << "PowerHAL ready to take hints, Adpf update rate: " << mAdpfRateNs;
 }
 
 ndk::ScopedAStatus Power::setMode(Mode type, bool enabled) {
     LOG(DEBUG) << "Power setMode: " << toString(type) << " to: " << enabled;
+    if (mInitGate.Defer([this, type, enabled] { applyMode(type, enabled); })) {
+        LOG(INFO) << "Power setMode: " << toString(type) << " queued until init";
+        return ndk::ScopedAStatus::ok();
+    }
+    applyMode(type, enabled);
+    return ndk::ScopedAStatus::ok();
+}
+
+void Power::applyMode(Mode type, bool enabled) {
     PowerSessionManager::getInstance()->updateHintMode(toString(type), enabled);
+    // Composed modes (e.g. VR, SUSTAINED_PERFORMANCE) and what they
+    // suppress are declared in the ModeComposition section of the config.
+    if (mModeComposer->IsManaged(toString(type))) {
+        mModeComposer->SetMode(toString(type), enabled);
+        return;
+    }
+    if (enabled && mModeComposer->IsModeSuppressed(toString(type))) {
+        return;
+    }
     switch (type) {
         case Mode::LOW_POWER:
             if (enabled) {
-                mHintManager->DoHint(toString(type));
+                mHintCoalescer->DoHint(toString(type));
             } else {
-                mHintManager->EndHint(toString(type));
-            }
-            break;
-        case Mode::SUSTAINED_PERFORMANCE:
-            if (enabled && !mSustainedPerfModeOn) {
-                if (!mVRModeOn) {  // Sustained mode only.
-                    mHintManager->DoHint("SUSTAINED_PERFORMANCE");
-                } else {  // Sustained + VR mode.
-                    mHintManager->EndHint("VR");
-                    mHintManager->DoHint("VR_SUSTAINED_PERFORMANCE");
-                }
-                mSustainedPerfModeOn = true;
-            } else if (!enabled && mSustainedPerfModeOn) {
-                mHintManager->EndHint("VR_SUSTAINED_PERFORMANCE");
-                mHintManager->EndHint("SUSTAINED_PERFORMANCE");
-                if (mVRModeOn) {  // Switch back to VR Mode.
-                    mHintManager->DoHint("VR");
-                }
-                mSustainedPerfModeOn = false;
-            }
-            break;
-        case Mode::VR:
-            if (enabled && !mVRModeOn) {
-                if (!mSustainedPerfModeOn) {  // VR mode only.
-                    mHintManager->DoHint("VR");
-                } else {  // Sustained + VR mode.
-                    mHintManager->EndHint("SUSTAINED_PERFORMANCE");
-                    mHintManager->DoHint("VR_SUSTAINED_PERFORMANCE");
-                }
-                mVRModeOn = true;
-            } else if (!enabled && mVRModeOn) {
-                mHintManager->EndHint("VR_SUSTAINED_PERFORMANCE");
-                mHintManager->EndHint("VR");
-                if (mSustainedPerfModeOn) {  // Switch back to sustained Mode.
-                    mHintManager->DoHint("SUSTAINED_PERFORMANCE");
-                }
-                mVRModeOn = false;
+                mHintCoalescer->EndHint(toString(type));
             }
             break;
         case Mode::LAUNCH:
-            if (mVRModeOn || mSustainedPerfModeOn) {
-                break;
-            }
             [[fallthrough]];
         case Mode::DOUBLE_TAP_TO_WAKE:
             [[fallthrough]];
@@ -166,18 +145,17 @@ ndk::ScopedAStatus Power::setMode(Mode type, bool enabled) {
             [[fallthrough]];
         default:
             if (enabled) {
-                mHintManager->DoHint(toString(type));
+                mHintCoalescer->DoHint(toString(type));
             } else {
-                mHintManager->EndHint(toString(type));
+                mHintCoalescer->EndHint(toString(type));
             }
             break;
     }
-
-    return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Power::isModeSupported(Mode type, bool *_aidl_return) {
-    bool supported = mHintManager->IsHintSupported(toString(type));
+    bool supported = mInitGate.WaitReady(kInitWaitTimeout) &&
+                     mHintManager->IsHintSupported(toString(type));
     switch (type) {
         case Mode::LOW_POWER: // LOW_POWER handled insides PowerHAL specifically
             supported = true;
@@ -199,9 +177,13 @@ ndk::ScopedAStatus Power::isModeSupported(Mode type, bool *_aidl_return) {
 
 ndk::ScopedAStatus Power::setBoost(Boost type, int32_t durationMs) {
     LOG(DEBUG) << "Power setBoost: " << toString(type) << " duration: " << durationMs;
+    if (!mInitGate.IsReady()) {
+        // Boosts are transient, there is nothing to replay once init is done.
+        return ndk::ScopedAStatus::ok();
+    }
     switch (type) {
         case Boost::INTERACTION:
-            if (mVRModeOn || mSustainedPerfModeOn) {
+            if (mModeComposer->IsBoostSuppressed(toString(type))) {
                 break;
             }
             mInteractionHandler->Acquire(durationMs);
@@ -217,15 +199,15 @@ ndk::ScopedAStatus Power::setBoost(Boost type, int32_t durationMs) {
         case Boost::CAMERA_SHOT:
             [[fallthrough]];
         default:
-            if (mVRModeOn || mSustainedPerfModeOn) {
+            if (mModeComposer->IsBoostSuppressed(toString(type))) {
                 break;
             }
             if (durationMs > 0) {
-                mHintManager->DoHint(toString(type), std::chrono::milliseconds(durationMs));
+                mHintCoalescer->DoHint(toString(type), std::chrono::milliseconds(durationMs));
             } else if (durationMs == 0) {
-                mHintManager->DoHint(toString(type));
+                mHintCoalescer->DoHint(toString(type));
             } else {
-                mHintManager->EndHint(toString(type));
+                mHintCoalescer->EndHint(toString(type));
             }
             break;
     }
@@ -234,7 +216,8 @@ ndk::ScopedAStatus Power::setBoost(Boost type, int32_t durationMs) {
 }
 
 ndk::ScopedAStatus Power::isBoostSupported(Boost type, bool *_aidl_return) {
-    bool supported = mHintManager->IsHintSupported(toString(type));
+    bool supported = mInitGate.WaitReady(kInitWaitTimeout) &&
+                     mHintManager->IsHintSupported(toString(type));
     LOG(INFO) << "Power boost " << toString(type) << " isBoostSupported: " << supported;
     *_aidl_return = supported;
     return ndk::ScopedAStatus::ok();
@@ -245,17 +228,24 @@ constexpr const char *boolToString(bool b) {
 }
 
 binder_status_t Power::dump(int fd, const char **, uint32_t) {
-    std::string buf(::android::base::StringPrintf(
-            "HintManager Running: %s\n"
-            "VRMode: %s\n"
-            "SustainedPerformanceMode: %s\n",
-            boolToString(mHintManager->IsRunning()), boolToString(mVRModeOn),
-            boolToString(mSustainedPerfModeOn)));
+    if (!mInitGate.IsReady()) {
+        if (!::android::base::WriteStringToFd("PowerHAL initializing\n", fd)) {
+            PLOG(ERROR) << "Failed to dump state to fd";
+        }
+        return STATUS_OK;
+    }
+    std::string buf(::android::base::StringPrintf("HintManager Running: %s\n",
+                                                  boolToString(mHintManager->IsRunning())));
     // Dump nodes through libperfmgr
     mHintManager->DumpToFd(fd);
     if (!::android::base::WriteStringToFd(buf, fd)) {
         PLOG(ERROR) << "Failed to dump state to fd";
     }
+    mModeComposer->DumpToFd(fd);
+    mHintCoalescer->DumpToFd(fd);
+    mPowerExt->DumpToFd(fd);
+    mInteractionHandler->DumpToFd(fd);
+    PowerSessionManager::getInstance()->dumpToFd(fd);
     fsync(fd);
     return STATUS_OK;
 }
@@ -18,12 +18,17 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <thread>
 
 #include <aidl/android/hardware/power/BnPower.h>
 #include <perfmgr/HintManager.h>
 
+#include "HintCoalescer.h"
+#include "InitGate.h"
 #include "InteractionHandler.h"
+#include "ModeComposer.h"
+#include "PowerExt.h"
 
 namespace aidl {
 namespace google {
@@ -39,7 +44,11 @@ using ::android::perfmgr::HintManager;
 
 class Power : public ::aidl::android::hardware::power::BnPower {
   public:
-    Power(std::shared_ptr<HintManager> hm);
+    Power();
+    // Called once from the init worker; state changes received before this are
+    // replayed afterwards.
+    void Init(std::shared_ptr<HintManager> hm, std::shared_ptr<ModeComposer> mc,
+              std::shared_ptr<HintCoalescer> hc, std::shared_ptr<PowerExt> ext);
     ndk::ScopedAStatus setMode(Mode type, bool enabled) override;
     ndk::ScopedAStatus isModeSupported(Mode type, bool *_aidl_return) override;
     ndk::ScopedAStatus setBoost(Boost type, int32_t durationMs) override;
@@ -52,10 +61,14 @@ class Power : public ::aidl::android::hardware::power::BnPower {
     binder_status_t dump(int fd, const char **args, uint32_t numArgs) override;
 
   private:
+    void applyMode(Mode type, bool enabled);
+    InitGate mInitGate;
+    // Set once by Init() before mInitGate opens.
     std::shared_ptr<HintManager> mHintManager;
     std::unique_ptr<InteractionHandler> mInteractionHandler;
-    std::atomic<bool> mVRModeOn;
-    std::atomic<bool> mSustainedPerfModeOn;
+    std::shared_ptr<ModeComposer> mModeComposer;
+    std::shared_ptr<HintCoalescer> mHintCoalescer;
+    std::shared_ptr<PowerExt> mPowerExt;
     const int64_t mAdpfRateNs;
 };
 
@@ -26,6 +26,7 @@
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android/binder_ibinder.h>
 
 #include <utils/Log.h>
 
@@ -36,21 +37,45 @@ namespace power {
 namespace impl {
 namespace pixel {
 
+// How long support queries wait for the config before answering unsupported.
+constexpr std::chrono::milliseconds kInitWaitTimeout(5000);
+
+void PowerExt::Init(std::shared_ptr<HintManager> hm, std::shared_ptr<HintCoalescer> hc,
+                    std::shared_ptr<BoostGovernor> bg, std::shared_ptr<BoostAccounting> ba) {
+    mHintManager = std::move(hm);
+    mHintCoalescer = std::move(hc);
+    mBoostGovernor = std::move(bg);
+    mBoostAccounting = std::move(ba);
+    mInitGate.Open();
+}
+
 ndk::ScopedAStatus PowerExt::setMode(const std::string &mode, bool enabled) {
     LOG(DEBUG) << "PowerExt setMode: " << mode << " to: " << enabled;
+    if (mInitGate.Defer([this, mode, enabled] { applyMode(mode, enabled); })) {
+        LOG(INFO) << "PowerExt setMode: " << mode << " queued until init";
+        return ndk::ScopedAStatus::ok();
+    }
+    applyMode(mode, enabled);
+    return ndk::ScopedAStatus::ok();
+}
 
+void PowerExt::applyMode(const std::string &mode, bool enabled) {
     if (enabled) {
-        mHintManager->DoHint(mode);
+        const std::string hint = mBoostGovernor->Begin(mode, nullptr);
+        if (!hint.empty()) {
+            mHintCoalescer->DoHint(hint);
+        }
     } else {
-        mHintManager->EndHint(mode);
+        const std::string hint = mBoostGovernor->End(mode);
+        if (!hint.empty()) {
+            mHintCoalescer->EndHint(hint);
+        }
     }
     PowerSessionManager::getInstance()->updateHintMode(mode, enabled);
-
-    return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus PowerExt::isModeSupported(const std::string &mode, bool *_aidl_return) {
-    bool supported = mHintManager->IsHintSupported(mode);
+    bool supported = mInitGate.WaitReady(kInitWaitTimeout) && mHintManager->IsHintSupported(mode);
     LOG(INFO) << "PowerExt mode " << mode << " isModeSupported: " << supported;
     *_aidl_return = supported;
     return ndk::ScopedAStatus::ok();
@@ -58,25 +83,52 @@ ndk::ScopedAStatus PowerExt::isModeSupported(const std::string &mode, bool *_aid
 
 ndk::ScopedAStatus PowerExt::setBoost(const std::string &boost, int32_t durationMs) {
     LOG(DEBUG) << "PowerExt setBoost: " << boost << " duration: " << durationMs;
+    if (!mInitGate.IsReady()) {
+        return ndk::ScopedAStatus::ok();
+    }
+
+    const uid_t uid = AIBinder_getCallingUid();
+    if (durationMs < 0) {
+        mBoostAccounting->End(uid, boost);
+        const std::string hint = mBoostGovernor->End(boost);
+        if (!hint.empty()) {
+            mHintCoalescer->EndHint(hint);
+        }
+        return ndk::ScopedAStatus::ok();
+    }
 
+    if (!mBoostAccounting->Admit(uid, boost, &durationMs)) {
+        return ndk::ScopedAStatus::ok();
+    }
+    const std::string hint = mBoostGovernor->Begin(boost, &durationMs);
+    if (hint.empty()) {
+        return ndk::ScopedAStatus::ok();
+    }
+    mBoostAccounting->Charge(uid, boost, durationMs);
     if (durationMs > 0) {
-        mHintManager->DoHint(boost, std::chrono::milliseconds(durationMs));
-    } else if (durationMs == 0) {
-        mHintManager->DoHint(boost);
+        mHintCoalescer->DoHint(hint, std::chrono::milliseconds(durationMs));
     } else {
-        mHintManager->EndHint(boost);
+        mHintCoalescer->DoHint(hint);
     }
 
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus PowerExt::isBoostSupported(const std::string &boost, bool *_aidl_return) {
-    bool supported = mHintManager->IsHintSupported(boost);
+    bool supported = mInitGate.WaitReady(kInitWaitTimeout) && mHintManager->IsHintSupported(boost);
     LOG(INFO) << "PowerExt boost " << boost << " isBoostSupported: " << supported;
     *_aidl_return = supported;
     return ndk::ScopedAStatus::ok();
 }
 
+void PowerExt::DumpToFd(int fd) {
+    if (!mInitGate.IsReady()) {
+        return;
+    }
+    mBoostGovernor->DumpToFd(fd);
+    mBoostAccounting->DumpToFd(fd);
+}
+
 }  // namespace pixel
 }  // namespace impl
 }  // namespace power
@@ -23,6 +23,11 @@
 #include <aidl/google/hardware/power/extension/pixel/BnPowerExt.h>
 #include <perfmgr/HintManager.h>
 
+#include "BoostAccounting.h"
+#include "BoostGovernor.h"
+#include "HintCoalescer.h"
+#include "InitGate.h"
+
 namespace aidl {
 namespace google {
 namespace hardware {
@@ -34,15 +39,29 @@ using ::android::perfmgr::HintManager;
 
 class PowerExt : public ::aidl::google::hardware::power::extension::pixel::BnPowerExt {
   public:
-    PowerExt(std::shared_ptr<HintManager> hm)
-        : mHintManager(hm) {}
+    PowerExt()
+        : mHintManager(nullptr),
+          mHintCoalescer(nullptr),
+          mBoostGovernor(nullptr),
+          mBoostAccounting(nullptr) {}
+    // Called once from the init worker; modes set before this are replayed.
+    void Init(std::shared_ptr<HintManager> hm, std::shared_ptr<HintCoalescer> hc,
+              std::shared_ptr<BoostGovernor> bg, std::shared_ptr<BoostAccounting> ba);
+    // Called from Power::dump, the extension binder is not dumped on its own.
+    void DumpToFd(int fd);
     ndk::ScopedAStatus setMode(const std::string &mode, bool enabled) override;
     ndk::ScopedAStatus isModeSupported(const std::string &mode, bool *_aidl_return) override;
     ndk::ScopedAStatus setBoost(const std::string &boost, int32_t durationMs) override;
     ndk::ScopedAStatus isBoostSupported(const std::string &boost, bool *_aidl_return) override;
 
   private:
+    void applyMode(const std::string &mode, bool enabled);
+    InitGate mInitGate;
+    // Set once by Init() before mInitGate opens.
     std::shared_ptr<HintManager> mHintManager;
+    std::shared_ptr<HintCoalescer> mHintCoalescer;
+    std::shared_ptr<BoostGovernor> mBoostGovernor;
+    std::shared_ptr<BoostAccounting> mBoostAccounting;
 };
 
 }  // namespace pixel
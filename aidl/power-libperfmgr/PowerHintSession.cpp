@@ -21,11 +21,13 @@
 #include <android-base/parsedouble.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <processgroup/processgroup.h>
 #include <sys/syscall.h>
 #include <time.h>
 #include <utils/Trace.h>
 #include <atomic>
 
+#include "AdpfPidController.h"
 #include "PowerHintSession.h"
 #include "PowerSessionManager.h"
 
@@ -57,6 +59,16 @@ constexpr char kPowerHalAdpfStaleTimeFactor[] = "vendor.powerhal.adpf.stale_time
 constexpr char kPowerHalAdpfPSamplingWindow[] = "vendor.powerhal.adpf.p.window";
 constexpr char kPowerHalAdpfISamplingWindow[] = "vendor.powerhal.adpf.i.window";
 constexpr char kPowerHalAdpfDSamplingWindow[] = "vendor.powerhal.adpf.d.window";
+constexpr char kPowerHalAdpfTelemetrySize[] = "vendor.powerhal.adpf.telemetry.size";
+constexpr char kPowerHalAdpfFeedForward[] = "vendor.powerhal.adpf.feed_forward";
+constexpr char kPowerHalAdpfRefreshRateAware[] = "vendor.powerhal.adpf.refresh_rate_aware";
+constexpr char kPowerHalAdpfEscalationReports[] = "vendor.powerhal.adpf.escalation.reports";
+constexpr char kPowerHalAdpfEscalationReleaseReports[] =
+        "vendor.powerhal.adpf.escalation.release_reports";
+constexpr char kPowerHalAdpfEscalationTaskProfile[] =
+        "vendor.powerhal.adpf.escalation.task_profile";
+constexpr char kPowerHalAdpfEscalationReleaseTaskProfile[] =
+        "vendor.powerhal.adpf.escalation.release_task_profile";
 
 namespace {
 /* there is no glibc or bionic wrapper */
@@ -83,8 +95,8 @@ static int sched_setattr(int pid, struct sched_attr *attr, unsigned int flags) {
     return syscall(__NR_sched_setattr, pid, attr, flags);
 }
 
-static inline int64_t ns_to_100us(int64_t ns) {
-    return ns / 100000;
+static inline uint64_t packUclamp(int32_t min, int32_t max) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(min)) << 32) | static_cast<uint32_t>(max);
 }
 
 static double getDoubleProperty(const char *prop, double value) {
@@ -95,61 +107,167 @@ static double getDoubleProperty(const char *prop, double value) {
     return value;
 }
 
-static double sPidPOver = getDoubleProperty(kPowerHalAdpfPidPOver, 2.0);
-static double sPidPUnder = getDoubleProperty(kPowerHalAdpfPidPUnder, 1.0);
-static double sPidI = getDoubleProperty(kPowerHalAdpfPidI, 0.001);
-static double sPidDOver = getDoubleProperty(kPowerHalAdpfPidDOver, 500.0);
-static double sPidDUnder = getDoubleProperty(kPowerHalAdpfPidDUnder, 0.0);
-static const int64_t sPidIInit =
-        (sPidI == 0) ? 0
-                     : static_cast<int64_t>(::android::base::GetIntProperty<int64_t>(
-                                                    kPowerHalAdpfPidIInit, 200) /
-                                            sPidI);
-static const int64_t sPidIHighLimit =
-        (sPidI == 0) ? 0
-                     : static_cast<int64_t>(::android::base::GetIntProperty<int64_t>(
-                                                    kPowerHalAdpfPidIHighLimit, 512) /
-                                            sPidI);
-static const int64_t sPidILowLimit =
-        (sPidI == 0) ? 0
-                     : static_cast<int64_t>(::android::base::GetIntProperty<int64_t>(
-                                                    kPowerHalAdpfPidILowLimit, -30) /
-                                            sPidI);
-static const int32_t sUclampMinHighLimit =
-        ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfUclampMinHighLimit, 384);
-static const int32_t sUclampMinLowLimit =
-        ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfUclampMinLowLimit, 2);
-static const uint32_t sUclampMinGranularity =
-        ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfUclampMinGranularity, 5);
+static AdpfPidConfig loadPidConfig() {
+    AdpfPidConfig config;
+    config.pOver = getDoubleProperty(kPowerHalAdpfPidPOver, config.pOver);
+    config.pUnder = getDoubleProperty(kPowerHalAdpfPidPUnder, config.pUnder);
+    config.i = getDoubleProperty(kPowerHalAdpfPidI, config.i);
+    config.dOver = getDoubleProperty(kPowerHalAdpfPidDOver, config.dOver);
+    config.dUnder = getDoubleProperty(kPowerHalAdpfPidDUnder, config.dUnder);
+    config.iInit = ::android::base::GetIntProperty<int64_t>(kPowerHalAdpfPidIInit, config.iInit);
+    config.iHighLimit =
+            ::android::base::GetIntProperty<int64_t>(kPowerHalAdpfPidIHighLimit, config.iHighLimit);
+    config.iLowLimit =
+            ::android::base::GetIntProperty<int64_t>(kPowerHalAdpfPidILowLimit, config.iLowLimit);
+    config.pSamplingWindow = ::android::base::GetUintProperty<uint32_t>(
+            kPowerHalAdpfPSamplingWindow, config.pSamplingWindow);
+    config.iSamplingWindow = ::android::base::GetUintProperty<uint32_t>(
+            kPowerHalAdpfISamplingWindow, config.iSamplingWindow);
+    config.dSamplingWindow = ::android::base::GetUintProperty<uint32_t>(
+            kPowerHalAdpfDSamplingWindow, config.dSamplingWindow);
+    config.uclampMinHighLimit = ::android::base::GetUintProperty<uint32_t>(
+            kPowerHalAdpfUclampMinHighLimit, config.uclampMinHighLimit);
+    config.uclampMinLowLimit = ::android::base::GetUintProperty<uint32_t>(
+            kPowerHalAdpfUclampMinLowLimit, config.uclampMinLowLimit);
+    config.uclampMinGranularity = ::android::base::GetUintProperty<uint32_t>(
+            kPowerHalAdpfUclampMinGranularity, config.uclampMinGranularity);
+    return config;
+}
+
+static const AdpfPidConfig sPidConfig = loadPidConfig();
+static const int64_t sPidIInit = sPidConfig.integralInit();
+static const int32_t sUclampMinHighLimit = sPidConfig.uclampMinHighLimit;
+static const bool sFeedForward = ::android::base::GetBoolProperty(kPowerHalAdpfFeedForward, true);
+static const bool sRefreshRateAware =
+        ::android::base::GetBoolProperty(kPowerHalAdpfRefreshRateAware, true);
+// 0 disables escalation.
+static const uint32_t sEscalationReports =
+        ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfEscalationReports, 10);
+static const uint32_t sEscalationReleaseReports =
+        ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfEscalationReleaseReports, 30);
+// Optional task profiles to move escalated tids onto the big cores and back.
+static const std::string sEscalationTaskProfile =
+        ::android::base::GetProperty(kPowerHalAdpfEscalationTaskProfile, "");
+static const std::string sEscalationReleaseTaskProfile =
+        ::android::base::GetProperty(kPowerHalAdpfEscalationReleaseTaskProfile, "");
+static const size_t sTelemetrySize =
+        ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfTelemetrySize, 128, 4096);
 static const int64_t sStaleTimeFactor =
         ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfStaleTimeFactor, 20);
-static const int64_t sPSamplingWindow =
-        ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfPSamplingWindow, 1);
-static const int64_t sISamplingWindow =
-        ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfISamplingWindow, 0);
-static const int64_t sDSamplingWindow =
-        ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfDSamplingWindow, 1);
+static std::string makeIdString(int32_t tgid, int32_t uid, const void *session) {
+    return StringPrintf("%" PRId32 "-%" PRId32 "-%" PRIxPTR, tgid, uid,
+                        reinterpret_cast<uintptr_t>(session) & 0xffff);
+}
+
+static std::string makeTraceName(const std::string &idstr, const char *counter) {
+    return StringPrintf("adpf.%s-%s", idstr.c_str(), counter);
+}
 
 }  // namespace
 
+UclampApplier::UclampApplier(const std::vector<int> &threadIds)
+    : mThreadIds(threadIds),
+      mApplied(threadIds.size(), {-1, -1}),
+      mPending(0),
+      mHasPending(false),
+      mQueued(false) {}
+
+void UclampApplier::request(int32_t min, int32_t max) {
+    mPending.store(packUclamp(min, max));
+    mHasPending.store(true);
+    if (!PowerHintMonitor::getInstance()->isRunning()) {
+        flush();
+        return;
+    }
+    if (!mQueued.exchange(true)) {
+        PowerHintMonitor::getInstance()->getLooper()->sendMessage(this, NULL);
+    }
+}
+
+void UclampApplier::flush() {
+    std::lock_guard<std::mutex> guard(mApplyLock);
+    if (!mHasPending.exchange(false)) {
+        return;
+    }
+    const uint64_t pending = mPending.load();
+    applyLocked(static_cast<int32_t>(pending >> 32), static_cast<int32_t>(pending & 0xffffffff));
+}
+
+void UclampApplier::handleMessage(const Message &) {
+    // Clear before reading so that a request racing with us posts again.
+    mQueued.store(false);
+    flush();
+}
+
+void UclampApplier::applyLocked(int32_t min, int32_t max) {
+    uint32_t issued = 0;
+    uint32_t skipped = 0;
+    for (size_t i = 0; i < mThreadIds.size(); i++) {
+        const int tid = mThreadIds[i];
+        if (mApplied[i].first == min && mApplied[i].second == max) {
+            skipped++;
+            continue;
+        }
+        sched_attr attr = {};
+        attr.size = sizeof(attr);
+
+        attr.sched_flags = (SCHED_FLAG_KEEP_ALL | SCHED_FLAG_UTIL_CLAMP);
+        attr.sched_util_min = min;
+        attr.sched_util_max = max;
+
+        issued++;
+        int ret = sched_setattr(tid, &attr, 0);
+        if (ret) {
+            ALOGW("sched_setattr failed for thread %d, err=%d", tid, errno);
+            mApplied[i] = {-1, -1};
+            continue;
+        }
+        mApplied[i] = {min, max};
+        ALOGV("PowerHintSession tid: %d, uclamp(%d, %d)", tid, min, max);
+    }
+    PowerSessionManager::getInstance()->updateUclampStats(issued, skipped);
+}
+
+AdpfTraceNames::AdpfTraceNames(const std::string &idstr)
+    : target(makeTraceName(idstr, "target")),
+      active(makeTraceName(idstr, "active")),
+      stale(makeTraceName(idstr, "stale")),
+      wakeup(makeTraceName(idstr, "wakeup")),
+      min(makeTraceName(idstr, "min")),
+      err(makeTraceName(idstr, "err")),
+      integral(makeTraceName(idstr, "integral")),
+      derivative(makeTraceName(idstr, "derivative")),
+      actlLast(makeTraceName(idstr, "actl_last")),
+      sampleSize(makeTraceName(idstr, "sample_size")),
+      pidCount(makeTraceName(idstr, "pid.count")),
+      pidPOut(makeTraceName(idstr, "pid.pOut")),
+      pidIOut(makeTraceName(idstr, "pid.iOut")),
+      pidDOut(makeTraceName(idstr, "pid.dOut")),
+      pidOutput(makeTraceName(idstr, "pid.output")),
+      pidOvertime(makeTraceName(idstr, "pid.overtime")),
+      escalated(makeTraceName(idstr, "escalated")) {}
+
 PowerHintSession::PowerHintSession(int32_t tgid, int32_t uid, const std::vector<int32_t> &threadIds,
                                    int64_t durationNanos, const nanoseconds adpfRate)
-    : kAdpfRate(adpfRate) {
+    : mTraceNames(makeIdString(tgid, uid, this)), kAdpfRate(adpfRate) {
     mDescriptor = new AppHintDesc(tgid, uid, threadIds);
     mDescriptor->duration = std::chrono::nanoseconds(durationNanos);
     mStaleHandler = sp<StaleHandler>(new StaleHandler(this));
+    mUclampApplier = sp<UclampApplier>(new UclampApplier(mDescriptor->threadIds));
+    if (sTelemetrySize > 0) {
+        mTelemetry = std::make_unique<AdpfTelemetryRing>(sTelemetrySize);
+    }
     mPowerManagerHandler = PowerSessionManager::getInstance();
 
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-target", idstr.c_str());
-        ATRACE_INT(sz.c_str(), (int64_t)mDescriptor->duration.count());
-        sz = StringPrintf("adpf.%s-active", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->is_active.load());
-        sz = StringPrintf("adpf.%s-stale", idstr.c_str());
-        ATRACE_INT(sz.c_str(), isStale());
+        ATRACE_INT(mTraceNames.target.c_str(), (int64_t)mDescriptor->duration.count());
+        ATRACE_INT(mTraceNames.active.c_str(), mDescriptor->is_active.load());
+        ATRACE_INT(mTraceNames.stale.c_str(), isStale());
     }
     PowerSessionManager::getInstance()->addPowerSession(this);
+    // A session that never reports must still go stale and stop counting as active.
+    mStaleHandler->updateStaleTimer();
+    updateActiveCount(true);
     // init boost
     setUclamp(sUclampMinHighLimit);
     ALOGV("PowerHintSession created: %s", mDescriptor->toString().c_str());
@@ -159,27 +277,29 @@ PowerHintSession::~PowerHintSession() {
     close();
     ALOGV("PowerHintSession deleted: %s", mDescriptor->toString().c_str());
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-target", idstr.c_str());
-        ATRACE_INT(sz.c_str(), 0);
-        sz = StringPrintf("adpf.%s-actl_last", idstr.c_str());
-        ATRACE_INT(sz.c_str(), 0);
-        sz = sz = StringPrintf("adpf.%s-active", idstr.c_str());
-        ATRACE_INT(sz.c_str(), 0);
+        ATRACE_INT(mTraceNames.target.c_str(), 0);
+        ATRACE_INT(mTraceNames.actlLast.c_str(), 0);
+        ATRACE_INT(mTraceNames.active.c_str(), 0);
     }
     delete mDescriptor;
 }
 
 std::string PowerHintSession::getIdString() const {
-    std::string idstr = StringPrintf("%" PRId32 "-%" PRId32 "-%" PRIxPTR, mDescriptor->tgid,
-                                     mDescriptor->uid, reinterpret_cast<uintptr_t>(this) & 0xffff);
-    return idstr;
+    return makeIdString(mDescriptor->tgid, mDescriptor->uid, this);
 }
 
 void PowerHintSession::updateUniveralBoostMode() {
     PowerHintMonitor::getInstance()->getLooper()->sendMessage(mPowerManagerHandler, NULL);
 }
 
+bool PowerHintSession::updateActiveCount(bool active) {
+    if (mCountedActive.exchange(active) == active) {
+        return false;
+    }
+    PowerSessionManager::getInstance()->updateActiveSessionCount(active);
+    return true;
+}
+
 int PowerHintSession::setUclamp(int32_t min, int32_t max) {
     std::lock_guard<std::mutex> guard(mLock);
     min = std::max(0, min);
@@ -187,54 +307,48 @@ int PowerHintSession::setUclamp(int32_t min, int32_t max) {
     max = std::max(0, max);
     max = std::max(min, max);
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-min", idstr.c_str());
-        ATRACE_INT(sz.c_str(), min);
-    }
-    for (const auto tid : mDescriptor->threadIds) {
-        sched_attr attr = {};
-        attr.size = sizeof(attr);
-
-        attr.sched_flags = (SCHED_FLAG_KEEP_ALL | SCHED_FLAG_UTIL_CLAMP);
-        attr.sched_util_min = min;
-        attr.sched_util_max = max;
-
-        int ret = sched_setattr(tid, &attr, 0);
-        if (ret) {
-            ALOGW("sched_setattr failed for thread %d, err=%d", tid, errno);
-        }
-        ALOGV("PowerHintSession tid: %d, uclamp(%d, %d)", tid, min, max);
+        ATRACE_INT(mTraceNames.min.c_str(), min);
     }
+    mUclampApplier->request(min, max);
     mDescriptor->current_min = min;
     return 0;
 }
 
 ndk::ScopedAStatus PowerHintSession::pause() {
+    std::lock_guard<std::mutex> guard(mSessionLock);
     if (!mDescriptor->is_active.load())
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     // Reset to default uclamp value.
     setUclamp(0);
+    setEscalated(false);
     mDescriptor->is_active.store(false);
+    updateActiveCount(false);
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-active", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->is_active.load());
+        ATRACE_INT(mTraceNames.active.c_str(), mDescriptor->is_active.load());
     }
     updateUniveralBoostMode();
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus PowerHintSession::resume() {
+    std::lock_guard<std::mutex> guard(mSessionLock);
     if (mDescriptor->is_active.load())
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     mDescriptor->is_active.store(true);
-    mDescriptor->integral_error = std::max(sPidIInit, mDescriptor->integral_error);
-    // resume boost
-    setUclamp(sUclampMinHighLimit);
+    mStaleHandler->updateStaleTimer();
+    updateActiveCount(true);
+    int32_t learned_min;
+    if (sFeedForward && mDescriptor->feed_forward.seed(sPidConfig, mDescriptor->duration.count(),
+                                                       &mDescriptor->pid, &learned_min)) {
+        // resume from what met this target before
+        setUclamp(learned_min);
+    } else {
+        mDescriptor->pid.integralError = std::max(sPidIInit, mDescriptor->pid.integralError);
+        // resume boost
+        setUclamp(sUclampMinHighLimit);
+    }
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-active", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->is_active.load());
+        ATRACE_INT(mTraceNames.active.c_str(), mDescriptor->is_active.load());
     }
     updateUniveralBoostMode();
     return ndk::ScopedAStatus::ok();
@@ -245,8 +359,18 @@ ndk::ScopedAStatus PowerHintSession::close() {
     if (!mSessionClosed.compare_exchange_strong(sessionClosedExpectedToBe, true)) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
-    PowerHintMonitor::getInstance()->getLooper()->removeMessages(mStaleHandler);
-    setUclamp(0);
+    // Not under mSessionLock: cancel() waits for a running stale check.
+    PowerHintMonitor::getInstance()->getStaleTimerWheel()->cancel(mStaleHandler);
+    {
+        std::lock_guard<std::mutex> guard(mSessionLock);
+        setUclamp(0);
+        setEscalated(false);
+        // Make sure the reset lands before the task profiles are dropped.
+        mUclampApplier->flush();
+        updateActiveCount(false);
+    }
+    // PowerSessionManager calls into sessions with its lock held, so take it
+    // only after releasing mSessionLock.
     PowerSessionManager::getInstance()->removePowerSession(this);
     updateUniveralBoostMode();
     return ndk::ScopedAStatus::ok();
@@ -258,16 +382,23 @@ ndk::ScopedAStatus PowerHintSession::updateTargetWorkDuration(int64_t targetDura
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
     ALOGV("update target duration: %" PRId64 " ns", targetDurationNanos);
-    double ratio =
-            targetDurationNanos == 0 ? 1.0 : mDescriptor->duration.count() / targetDurationNanos;
-    mDescriptor->integral_error =
-            std::max(sPidIInit, static_cast<int64_t>(mDescriptor->integral_error * ratio));
+    std::lock_guard<std::mutex> guard(mSessionLock);
+    int32_t learned_min;
+    const bool seeded = sFeedForward && mDescriptor->is_active.load() &&
+                        mDescriptor->feed_forward.seed(sPidConfig, targetDurationNanos,
+                                                       &mDescriptor->pid, &learned_min);
+    if (!seeded) {
+        adpfPidUpdateTarget(sPidConfig, &mDescriptor->pid, mDescriptor->duration.count(),
+                            targetDurationNanos);
+    }
 
     mDescriptor->duration = std::chrono::nanoseconds(targetDurationNanos);
+    if (seeded) {
+        // Jump to what met this target before; the PID corrects the residual.
+        setUclamp(learned_min);
+    }
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-target", idstr.c_str());
-        ATRACE_INT(sz.c_str(), (int64_t)mDescriptor->duration.count());
+        ATRACE_INT(mTraceNames.target.c_str(), (int64_t)mDescriptor->duration.count());
     }
 
     return ndk::ScopedAStatus::ok();
@@ -275,6 +406,7 @@ ndk::ScopedAStatus PowerHintSession::updateTargetWorkDuration(int64_t targetDura
 
 ndk::ScopedAStatus PowerHintSession::reportActualWorkDuration(
         const std::vector<WorkDuration> &actualDurations) {
+    std::lock_guard<std::mutex> guard(mSessionLock);
     if (mDescriptor->duration.count() == 0LL) {
         ALOGE("Expect to call updateTargetWorkDuration() first.");
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
@@ -288,96 +420,80 @@ ndk::ScopedAStatus PowerHintSession::reportActualWorkDuration(
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
     if (PowerHintMonitor::getInstance()->isRunning() && isStale()) {
-        mDescriptor->integral_error = std::max(sPidIInit, mDescriptor->integral_error);
+        mDescriptor->pid.integralError = std::max(sPidIInit, mDescriptor->pid.integralError);
         if (ATRACE_ENABLED()) {
-            const std::string idstr = getIdString();
-            std::string sz = StringPrintf("adpf.%s-wakeup", idstr.c_str());
-            ATRACE_INT(sz.c_str(), mDescriptor->integral_error);
-            ATRACE_INT(sz.c_str(), 0);
+            ATRACE_INT(mTraceNames.wakeup.c_str(), mDescriptor->pid.integralError);
+            ATRACE_INT(mTraceNames.wakeup.c_str(), 0);
         }
     }
-    int64_t targetDurationNanos = (int64_t)mDescriptor->duration.count();
-    int64_t length = actualDurations.size();
-    int64_t p_start =
-            sPSamplingWindow == 0 || sPSamplingWindow > length ? 0 : length - sPSamplingWindow;
-    int64_t i_start =
-            sISamplingWindow == 0 || sISamplingWindow > length ? 0 : length - sISamplingWindow;
-    int64_t d_start =
-            sDSamplingWindow == 0 || sDSamplingWindow > length ? 0 : length - sDSamplingWindow;
-    int64_t dt = ns_to_100us(targetDurationNanos);
-    int64_t err_sum = 0;
-    int64_t derivative_sum = 0;
-    for (int64_t i = std::min({p_start, i_start, d_start}); i < length; i++) {
-        int64_t actualDurationNanos = actualDurations[i].durationNanos;
-        if (std::abs(actualDurationNanos) > targetDurationNanos * 20) {
-            ALOGW("The actual duration is way far from the target (%" PRId64 " >> %" PRId64 ")",
-                  actualDurationNanos, targetDurationNanos);
-        }
-        // PID control algorithm
-        int64_t error = ns_to_100us(actualDurationNanos - targetDurationNanos);
-        if (i >= d_start) {
-            derivative_sum += error - mDescriptor->previous_error;
+    // Feed-forward and telemetry are keyed on the target the app asked for;
+    // only the PID step runs against the vsync-snapped deadline.
+    const int64_t requestedDurationNanos = (int64_t)mDescriptor->duration.count();
+    int64_t targetDurationNanos = requestedDurationNanos;
+    AdpfPidConfig config = sPidConfig;
+    if (sRefreshRateAware) {
+        const int rate = PowerSessionManager::getInstance()->getDisplayRefreshRate();
+        if (mPidRefreshRate != 0 && rate > mPidRefreshRate) {
+            // Carry the integral over to the shorter frame budget.
+            adpfPidUpdateTarget(sPidConfig, &mDescriptor->pid, 1000000000LL / mPidRefreshRate,
+                                1000000000LL / rate);
         }
-        if (i >= p_start) {
-            err_sum += error;
-        }
-        if (i >= i_start) {
-            mDescriptor->integral_error = mDescriptor->integral_error + error * dt;
-            mDescriptor->integral_error = std::min(sPidIHighLimit, mDescriptor->integral_error);
-            mDescriptor->integral_error = std::max(sPidILowLimit, mDescriptor->integral_error);
-        }
-        mDescriptor->previous_error = error;
+        mPidRefreshRate = rate;
+        config = adpfPidConfigForRefreshRate(sPidConfig, rate);
+        targetDurationNanos = adpfSnapToVsync(targetDurationNanos, rate);
+    }
+    int64_t length = actualDurations.size();
+    const AdpfPidOutput pid =
+            adpfPidStep(config, &mDescriptor->pid, targetDurationNanos, length,
+                        [&actualDurations](int64_t i) { return actualDurations[i].durationNanos; });
+    if (pid.outliers > 0) {
+        ALOGW("%zu actual durations are way far from the target (%" PRId64 ")", pid.outliers,
+              targetDurationNanos);
     }
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-err", idstr.c_str());
-        ATRACE_INT(sz.c_str(), err_sum / (length - p_start));
-        sz = StringPrintf("adpf.%s-integral", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->integral_error);
-        sz = StringPrintf("adpf.%s-derivative", idstr.c_str());
-        ATRACE_INT(sz.c_str(), derivative_sum / dt / (length - d_start));
-    }
-    int64_t pOut = static_cast<int64_t>((err_sum > 0 ? sPidPOver : sPidPUnder) * err_sum /
-                                        (length - p_start));
-    int64_t iOut = static_cast<int64_t>(sPidI * mDescriptor->integral_error);
-    int64_t dOut = static_cast<int64_t>((derivative_sum > 0 ? sPidDOver : sPidDUnder) *
-                                        derivative_sum / dt / (length - d_start));
-
-    int64_t output = pOut + iOut + dOut;
+        ATRACE_INT(mTraceNames.err.c_str(), pid.errAvg);
+        ATRACE_INT(mTraceNames.integral.c_str(), mDescriptor->pid.integralError);
+        ATRACE_INT(mTraceNames.derivative.c_str(), pid.derivativeAvg);
+    }
+    int64_t output = pid.output;
+    if (sFeedForward && !pid.overtime) {
+        // The uclamp.min in effect during these frames was enough.
+        mDescriptor->feed_forward.learn(requestedDurationNanos, mDescriptor->current_min);
+    }
 
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-actl_last", idstr.c_str());
-        ATRACE_INT(sz.c_str(), actualDurations[length - 1].durationNanos);
-        sz = StringPrintf("adpf.%s-target", idstr.c_str());
-        ATRACE_INT(sz.c_str(), (int64_t)mDescriptor->duration.count());
-        sz = StringPrintf("adpf.%s-sample_size", idstr.c_str());
-        ATRACE_INT(sz.c_str(), length);
-        sz = StringPrintf("adpf.%s-pid.count", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->update_count);
-        sz = StringPrintf("adpf.%s-pid.pOut", idstr.c_str());
-        ATRACE_INT(sz.c_str(), pOut);
-        sz = StringPrintf("adpf.%s-pid.iOut", idstr.c_str());
-        ATRACE_INT(sz.c_str(), iOut);
-        sz = StringPrintf("adpf.%s-pid.dOut", idstr.c_str());
-        ATRACE_INT(sz.c_str(), dOut);
-        sz = StringPrintf("adpf.%s-pid.output", idstr.c_str());
-        ATRACE_INT(sz.c_str(), output);
-        sz = StringPrintf("adpf.%s-stale", idstr.c_str());
-        ATRACE_INT(sz.c_str(), isStale());
-        sz = StringPrintf("adpf.%s-pid.overtime", idstr.c_str());
-        ATRACE_INT(sz.c_str(), err_sum > 0);
+        ATRACE_INT(mTraceNames.actlLast.c_str(), actualDurations[length - 1].durationNanos);
+        ATRACE_INT(mTraceNames.target.c_str(), (int64_t)mDescriptor->duration.count());
+        ATRACE_INT(mTraceNames.sampleSize.c_str(), length);
+        ATRACE_INT(mTraceNames.pidCount.c_str(), mDescriptor->update_count);
+        ATRACE_INT(mTraceNames.pidPOut.c_str(), pid.pOut);
+        ATRACE_INT(mTraceNames.pidIOut.c_str(), pid.iOut);
+        ATRACE_INT(mTraceNames.pidDOut.c_str(), pid.dOut);
+        ATRACE_INT(mTraceNames.pidOutput.c_str(), output);
+        ATRACE_INT(mTraceNames.stale.c_str(), isStale());
+        ATRACE_INT(mTraceNames.pidOvertime.c_str(), pid.overtime);
     }
     mDescriptor->update_count++;
 
     mStaleHandler->updateStaleTimer();
+    // A stale check racing with us waits for mSessionLock in setStale() and
+    // then sees the deadline moved above.
+    if (updateActiveCount(true)) {
+        updateUniveralBoostMode();
+    }
 
     /* apply to all the threads in the group */
-    if (output != 0) {
-        int next_min = std::min(sUclampMinHighLimit, static_cast<int>(output));
-        next_min = std::max(sUclampMinLowLimit, next_min);
-        if (std::abs(mDescriptor->current_min - next_min) > sUclampMinGranularity) {
-            setUclamp(next_min);
+    int32_t next_min;
+    if (adpfPidNextUclampMin(sPidConfig, output, mDescriptor->current_min, &next_min)) {
+        setUclamp(next_min);
+    }
+    updateEscalation(pid.overtime);
+
+    if (mTelemetry) {
+        for (const auto &duration : actualDurations) {
+            mTelemetry->push({duration.timeStampNanos, duration.durationNanos,
+                              requestedDurationNanos, pid.pOut, pid.iOut, pid.dOut,
+                              mDescriptor->current_min});
         }
     }
 
@@ -418,20 +534,99 @@ const std::vector<int> &PowerHintSession::getTidList() const {
     return mDescriptor->threadIds;
 }
 
+void PowerHintSession::dump(std::string *out) {
+    out->append(StringPrintf("ADPF session %s: active: %d, stale: %d, escalated: %d, "
+                             "updates: %" PRIu64 "\n",
+                             getIdString().c_str(), isActive(), isStale(), mEscalated.load(),
+                             mDescriptor->update_count));
+    out->append(mDescriptor->toString());
+    if (mTelemetry) {
+        mTelemetry->dump(out);
+    }
+}
+
+void PowerHintSession::updateEscalation(bool overtime) {
+    if (sEscalationReports == 0) {
+        return;
+    }
+    const bool saturated = overtime && mDescriptor->current_min >= sUclampMinHighLimit;
+    if (!mEscalated.load()) {
+        mSaturatedReports = saturated ? mSaturatedReports + 1 : 0;
+        if (mSaturatedReports >= sEscalationReports) {
+            setEscalated(true);
+        }
+        return;
+    }
+    // Release only after a run of met deadlines below the uclamp ceiling.
+    const bool relaxed = !overtime && mDescriptor->current_min < sUclampMinHighLimit;
+    mRelaxedReports = relaxed ? mRelaxedReports + 1 : 0;
+    if (mRelaxedReports >= sEscalationReleaseReports) {
+        setEscalated(false);
+    }
+}
+
+void PowerHintSession::setEscalated(bool escalated) {
+    if (mEscalated.exchange(escalated) == escalated) {
+        return;
+    }
+    mSaturatedReports = 0;
+    mRelaxedReports = 0;
+    const std::string &profile =
+            escalated ? sEscalationTaskProfile : sEscalationReleaseTaskProfile;
+    if (!profile.empty()) {
+        for (int tid : mDescriptor->threadIds) {
+            if (!SetTaskProfiles(tid, {profile})) {
+                ALOGW("Failed to set %s task profile for tid:%d", profile.c_str(), tid);
+            }
+        }
+    }
+    PowerSessionManager::getInstance()->updateBigClusterBoost(escalated);
+    if (ATRACE_ENABLED()) {
+        ATRACE_INT(mTraceNames.escalated.c_str(), escalated);
+    }
+}
+
+void PowerHintSession::onDisplayRefreshRateIncrease(int newRate) {
+    if (!sRefreshRateAware) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(mSessionLock);
+    if (mSessionClosed.load() || !isActive() || isStale() || mPidRefreshRate == 0 ||
+        newRate <= mPidRefreshRate) {
+        return;
+    }
+    // Carry the integral over to the shorter frame budget now instead of on
+    // the next report, and scale the current boost to match. The report path
+    // sees mPidRefreshRate already up to date and does not rescale again.
+    adpfPidUpdateTarget(sPidConfig, &mDescriptor->pid, 1000000000LL / mPidRefreshRate,
+                        1000000000LL / newRate);
+    const int32_t current = mDescriptor->current_min;
+    const int32_t boosted = std::min(sUclampMinHighLimit, current * newRate / mPidRefreshRate);
+    mPidRefreshRate = newRate;
+    if (boosted > current) {
+        setUclamp(boosted);
+    }
+}
+
 void PowerHintSession::setStale() {
+    std::lock_guard<std::mutex> guard(mSessionLock);
+    // A report or resume may have refreshed the session while we waited for
+    // the lock; it has put the handler back on the wheel.
+    if (std::chrono::steady_clock::now() <= mStaleHandler->getStaleTime()) {
+        return;
+    }
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-stale", idstr.c_str());
-        ATRACE_INT(sz.c_str(), 1);
+        ATRACE_INT(mTraceNames.stale.c_str(), 1);
     }
     // Reset to default uclamp value.
     setUclamp(0);
+    setEscalated(false);
+    updateActiveCount(false);
     // Deliver a task to check if all sessions are inactive.
     updateUniveralBoostMode();
 }
 
 void PowerHintSession::StaleHandler::updateStaleTimer() {
-    std::lock_guard<std::mutex> guard(mStaleLock);
     if (PowerHintMonitor::getInstance()->isRunning()) {
         auto when = getStaleTime();
         auto now = std::chrono::steady_clock::now();
@@ -439,16 +634,13 @@ void PowerHintSession::StaleHandler::updateStaleTimer() {
         if (now > when) {
             mSession->updateUniveralBoostMode();
         }
-        if (!mIsMonitoringStale.load()) {
-            auto next = getStaleTime();
-            PowerHintMonitor::getInstance()->getLooper()->sendMessageDelayed(
-                    duration_cast<nanoseconds>(next - now).count(), this, NULL);
-            mIsMonitoringStale.store(true);
+        // Moving the deadline forward needs no wheel work; the wheel entry is
+        // re-inserted lazily when it fires early.
+        if (!mIsMonitoringStale.exchange(true)) {
+            PowerHintMonitor::getInstance()->getStaleTimerWheel()->schedule(getStaleTime(), this);
         }
         if (ATRACE_ENABLED()) {
-            const std::string idstr = mSession->getIdString();
-            std::string sz = StringPrintf("adpf.%s-stale", idstr.c_str());
-            ATRACE_INT(sz.c_str(), 0);
+            ATRACE_INT(mSession->mTraceNames.stale.c_str(), 0);
         }
     }
 }
@@ -459,18 +651,22 @@ time_point<steady_clock> PowerHintSession::StaleHandler::getStaleTime() {
 }
 
 void PowerHintSession::StaleHandler::handleMessage(const Message &) {
-    std::lock_guard<std::mutex> guard(mStaleLock);
     auto now = std::chrono::steady_clock::now();
-    auto when = getStaleTime();
     // Check if the session is stale based on the last_updated_time.
-    if (now > when) {
-        mSession->setStale();
+    if (now > getStaleTime()) {
         mIsMonitoringStale.store(false);
-        return;
+        // A report racing with us either sees the cleared flag and requeues,
+        // or has already moved the deadline, which we re-check here.
+        if (now > getStaleTime()) {
+            mSession->setStale();
+            return;
+        }
+        if (mIsMonitoringStale.exchange(true)) {
+            return;
+        }
     }
-    // Schedule for the next checking time.
-    PowerHintMonitor::getInstance()->getLooper()->sendMessageDelayed(
-            duration_cast<nanoseconds>(when - now).count(), this, NULL);
+    // Deadline moved forward since scheduling; go back on the wheel.
+    PowerHintMonitor::getInstance()->getStaleTimerWheel()->schedule(getStaleTime(), this);
 }
 
 }  // namespace pixel
@@ -22,8 +22,12 @@
 #include <utils/Thread.h>
 
 #include <mutex>
+#include <string>
 #include <unordered_map>
 
+#include "AdpfPidController.h"
+#include "AdpfTelemetry.h"
+
 namespace aidl {
 namespace google {
 namespace hardware {
@@ -50,9 +54,7 @@ struct AppHintDesc {
           duration(0LL),
           current_min(0),
           is_active(true),
-          update_count(0),
-          integral_error(0),
-          previous_error(0) {}
+          update_count(0) {}
     std::string toString() const;
     const int32_t tgid;
     const int32_t uid;
@@ -63,8 +65,54 @@ struct AppHintDesc {
     std::atomic<bool> is_active;
     // pid
     uint64_t update_count;
-    int64_t integral_error;
-    int64_t previous_error;
+    AdpfPidState pid;
+    AdpfFeedForward feed_forward;
+};
+
+// Applies uclamp values to a fixed set of threads on the PowerHintMonitor
+// looper. Only the latest requested value is applied, and threads already
+// running with that value are skipped.
+class UclampApplier : public MessageHandler {
+  public:
+    explicit UclampApplier(const std::vector<int> &threadIds);
+    void request(int32_t min, int32_t max);
+    // Applies any pending request on the calling thread.
+    void flush();
+    void handleMessage(const Message &message) override;
+
+  private:
+    void applyLocked(int32_t min, int32_t max);
+    const std::vector<int> mThreadIds;
+    // Last values successfully applied per thread, -1 if unknown.
+    std::vector<std::pair<int32_t, int32_t>> mApplied;  // protected by mApplyLock
+    std::mutex mApplyLock;
+    // Packed (min << 32 | max) of the latest request.
+    std::atomic<uint64_t> mPending;
+    std::atomic<bool> mHasPending;
+    std::atomic<bool> mQueued;
+};
+
+// Per-session ATRACE counter names, built once so that tracing a report does
+// not allocate.
+struct AdpfTraceNames {
+    explicit AdpfTraceNames(const std::string &idstr);
+    const std::string target;
+    const std::string active;
+    const std::string stale;
+    const std::string wakeup;
+    const std::string min;
+    const std::string err;
+    const std::string integral;
+    const std::string derivative;
+    const std::string actlLast;
+    const std::string sampleSize;
+    const std::string pidCount;
+    const std::string pidPOut;
+    const std::string pidIOut;
+    const std::string pidDOut;
+    const std::string pidOutput;
+    const std::string pidOvertime;
+    const std::string escalated;
 };
 
 class PowerHintSession : public BnPowerHintSession {
@@ -81,6 +129,9 @@ class PowerHintSession : public BnPowerHintSession {
     bool isActive();
     bool isStale();
     const std::vector<int> &getTidList() const;
+    void dump(std::string *out);
+    // Called by PowerSessionManager when the panel switches to a higher rate.
+    void onDisplayRefreshRateIncrease(int newRate);
 
   private:
     class StaleHandler : public MessageHandler {
@@ -93,22 +144,41 @@ class PowerHintSession : public BnPowerHintSession {
 
       private:
         PowerHintSession *mSession;
+        // Whether this handler is queued on the stale timer wheel.
         std::atomic<bool> mIsMonitoringStale;
         std::atomic<time_point<steady_clock>> mLastUpdatedTime;
-        std::mutex mStaleLock;
     };
 
   private:
     void setStale();
     void updateUniveralBoostMode();
+    bool updateActiveCount(bool active);
+    void updateEscalation(bool overtime);
+    void setEscalated(bool escalated);
     int setUclamp(int32_t min, int32_t max = kMaxUclampValue);
     std::string getIdString() const;
     AppHintDesc *mDescriptor = nullptr;
+    const AdpfTraceNames mTraceNames;
     sp<StaleHandler> mStaleHandler;
+    sp<UclampApplier> mUclampApplier;
+    // Written by reportActualWorkDuration only, null if disabled.
+    std::unique_ptr<AdpfTelemetryRing> mTelemetry;
     sp<MessageHandler> mPowerManagerHandler;
     std::mutex mLock;
+    // Serializes the controller state of this session between binder threads
+    // and the stale timer; never held across calls into other sessions.
+    std::mutex mSessionLock;
     const nanoseconds kAdpfRate;
     std::atomic<bool> mSessionClosed = false;
+    // Whether this session is counted as active (not paused, closed or stale).
+    std::atomic<bool> mCountedActive = false;
+    // Refresh rate the PID state was last tuned for, protected by mSessionLock.
+    int mPidRefreshRate = 0;
+    // Consecutive saturated / relaxed reports, owned by the report path.
+    uint32_t mSaturatedReports = 0;
+    uint32_t mRelaxedReports = 0;
+    // Whether this session holds the big cluster escalation.
+    std::atomic<bool> mEscalated = false;
 };
 
 }  // namespace pixel
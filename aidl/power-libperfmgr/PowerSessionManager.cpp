@@ -17,6 +17,8 @@
 #define LOG_TAG "powerhal-libperfmgr"
 #define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
 
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
 #include <log/log.h>
 #include <processgroup/processgroup.h>
 #include <utils/Trace.h>
@@ -32,20 +34,47 @@ namespace pixel {
 
 void PowerSessionManager::setHintManager(std::shared_ptr<HintManager> const &hint_manager) {
     // Only initialize hintmanager instance if hint is supported.
+    if (hint_manager->IsHintSupported(kEscalationHintName)) {
+        std::lock_guard<std::mutex> guard(mEscalationLock);
+        mEscalationHintManager = hint_manager;
+    }
     if (hint_manager->IsHintSupported(kDisableBoostHintName)) {
+        std::lock_guard<std::mutex> guard(mTopAppBoostLock);
         mHintManager = hint_manager;
+        // Sessions are served before init completes; apply what they already
+        // asked for, as handleMessage() only acts on changes.
+        if (mActive.load()) {
+            disableSystemTopAppBoost();
+        }
     }
 }
 
+void PowerSessionManager::setBoostGovernor(std::shared_ptr<BoostGovernor> const &governor) {
+    std::lock_guard<std::mutex> guard(mEscalationLock);
+    mBoostGovernor = governor;
+}
+
 void PowerSessionManager::updateHintMode(const std::string &mode, bool enabled) {
     ALOGV("PowerSessionManager::updateHintMode: mode: %s, enabled: %d", mode.c_str(), enabled);
     if (enabled && mode.compare(0, 8, "REFRESH_") == 0) {
+        int rate = 0;
         if (mode.compare("REFRESH_120FPS") == 0) {
-            mDisplayRefreshRate = 120;
+            rate = 120;
         } else if (mode.compare("REFRESH_90FPS") == 0) {
-            mDisplayRefreshRate = 90;
+            rate = 90;
         } else if (mode.compare("REFRESH_60FPS") == 0) {
-            mDisplayRefreshRate = 60;
+            rate = 60;
+        }
+        if (rate == 0) {
+            return;
+        }
+        const int oldRate = mDisplayRefreshRate.exchange(rate);
+        if (rate > oldRate) {
+            // Shorter frame budget: boost now rather than after missed frames.
+            std::lock_guard<std::mutex> guard(mLock);
+            for (PowerHintSession *s : mSessions) {
+                s->onDisplayRefreshRateIncrease(rate);
+            }
         }
     }
 }
@@ -54,64 +83,73 @@ int PowerSessionManager::getDisplayRefreshRate() {
     return mDisplayRefreshRate;
 }
 
-void PowerSessionManager::addPowerSession(PowerHintSession *session) {
-    std::lock_guard<std::mutex> guard(mLock);
-    for (auto t : session->getTidList()) {
-        if (mTidRefCountMap.find(t) == mTidRefCountMap.end()) {
-            if (!SetTaskProfiles(t, {"ResetUclampGrp"})) {
-                ALOGW("Failed to set ResetUclampGrp task profile for tid:%d", t);
-            } else {
-                mTidRefCountMap[t] = 1;
-            }
-            continue;
+void TidRefCountTable::acquire(int tid) {
+    Shard &shard = getShard(tid);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.refCounts.find(tid);
+    if (it == shard.refCounts.end()) {
+        if (!SetTaskProfiles(tid, {"ResetUclampGrp"})) {
+            ALOGW("Failed to set ResetUclampGrp task profile for tid:%d", tid);
+        } else {
+            shard.refCounts[tid] = 1;
         }
-        if (mTidRefCountMap[t] <= 0) {
-            ALOGE("Error! Unexpected zero/negative RefCount:%d for tid:%d", mTidRefCountMap[t], t);
-            continue;
+        return;
+    }
+    if (it->second <= 0) {
+        ALOGE("Error! Unexpected zero/negative RefCount:%d for tid:%d", it->second, tid);
+        return;
+    }
+    it->second++;
+}
+
+void TidRefCountTable::release(int tid) {
+    Shard &shard = getShard(tid);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.refCounts.find(tid);
+    if (it == shard.refCounts.end()) {
+        ALOGE("Unexpected Error! Failed to look up tid:%d in TidRefCountMap", tid);
+        return;
+    }
+    if (--it->second <= 0) {
+        if (!SetTaskProfiles(tid, {"NoResetUclampGrp"})) {
+            ALOGW("Failed to set NoResetUclampGrp task profile for tid:%d", tid);
         }
-        mTidRefCountMap[t]++;
+        shard.refCounts.erase(it);
+    }
+}
+
+void PowerSessionManager::addPowerSession(PowerHintSession *session) {
+    for (auto t : session->getTidList()) {
+        mTidRefCounts.acquire(t);
     }
+    std::lock_guard<std::mutex> guard(mLock);
     mSessions.insert(session);
 }
 
 void PowerSessionManager::removePowerSession(PowerHintSession *session) {
-    std::lock_guard<std::mutex> guard(mLock);
     for (auto t : session->getTidList()) {
-        if (mTidRefCountMap.find(t) == mTidRefCountMap.end()) {
-            ALOGE("Unexpected Error! Failed to look up tid:%d in TidRefCountMap", t);
-            continue;
-        }
-        mTidRefCountMap[t]--;
-        if (mTidRefCountMap[t] <= 0) {
-            if (!SetTaskProfiles(t, {"NoResetUclampGrp"})) {
-                ALOGW("Failed to set NoResetUclampGrp task profile for tid:%d", t);
-            }
-            mTidRefCountMap.erase(t);
-        }
+        mTidRefCounts.release(t);
     }
+    std::lock_guard<std::mutex> guard(mLock);
     mSessions.erase(session);
 }
 
+void PowerSessionManager::updateActiveSessionCount(bool active) {
+    const int count = mActiveSessionCount.fetch_add(active ? 1 : -1) + (active ? 1 : -1);
+    ALOGE_IF(count < 0, "Error! Unexpected negative active session count:%d", count);
+}
+
 std::optional<bool> PowerSessionManager::isAnySessionActive() {
-    std::lock_guard<std::mutex> guard(mLock);
-    bool active = false;
-    for (PowerHintSession *s : mSessions) {
-        // session active and not stale is actually active.
-        if (s->isActive() && !s->isStale()) {
-            active = true;
-            break;
-        }
-    }
-    if (active == mActive) {
+    // Sessions keep mActiveSessionCount up to date on pause/resume/stale.
+    const bool active = mActiveSessionCount.load() > 0;
+    if (mActive.exchange(active) == active) {
         return std::nullopt;
-    } else {
-        mActive = active;
     }
-
     return active;
 }
 
 void PowerSessionManager::handleMessage(const Message &) {
+    std::lock_guard<std::mutex> guard(mTopAppBoostLock);
     auto active = isAnySessionActive();
     if (!active.has_value()) {
         return;
@@ -123,6 +161,63 @@ void PowerSessionManager::handleMessage(const Message &) {
     }
 }
 
+void PowerSessionManager::updateUclampStats(uint32_t issued, uint32_t skipped) {
+    mUclampSyscallsIssued.fetch_add(issued, std::memory_order_relaxed);
+    mUclampSyscallsSkipped.fetch_add(skipped, std::memory_order_relaxed);
+}
+
+void PowerSessionManager::updateBigClusterBoost(bool enable) {
+    std::lock_guard<std::mutex> guard(mEscalationLock);
+    if (enable) {
+        if (mEscalationCount++ == 0 && mEscalationHintManager) {
+            // The governor may drop the hint or swap in a throttled one.
+            const std::string hint = mBoostGovernor
+                                             ? mBoostGovernor->Begin(kEscalationHintName, nullptr)
+                                             : kEscalationHintName;
+            ALOGV("PowerSessionManager::updateBigClusterBoost: start %s -> %s",
+                  kEscalationHintName.c_str(), hint.c_str());
+            if (!hint.empty()) {
+                mEscalationHintManager->DoHint(hint);
+            }
+        }
+        return;
+    }
+    if (mEscalationCount <= 0) {
+        ALOGE("Error! Unexpected escalation count:%d", mEscalationCount);
+        return;
+    }
+    if (--mEscalationCount == 0 && mEscalationHintManager) {
+        const std::string hint =
+                mBoostGovernor ? mBoostGovernor->End(kEscalationHintName) : kEscalationHintName;
+        ALOGV("PowerSessionManager::updateBigClusterBoost: end %s", hint.c_str());
+        if (!hint.empty()) {
+            mEscalationHintManager->EndHint(hint);
+        }
+    }
+}
+
+void PowerSessionManager::dumpToFd(int fd) {
+    std::string buf(::android::base::StringPrintf(
+            "ADPF uclamp syscalls issued: %" PRIu64 "\n"
+            "ADPF uclamp syscalls skipped: %" PRIu64 "\n",
+            mUclampSyscallsIssued.load(std::memory_order_relaxed),
+            mUclampSyscallsSkipped.load(std::memory_order_relaxed)));
+    {
+        std::lock_guard<std::mutex> guard(mEscalationLock);
+        buf.append(::android::base::StringPrintf("ADPF escalated sessions: %d\n",
+                                                 mEscalationCount));
+    }
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        for (PowerHintSession *session : mSessions) {
+            session->dump(&buf);
+        }
+    }
+    if (!::android::base::WriteStringToFd(buf, fd)) {
+        ALOGE("Failed to dump ADPF state to fd");
+    }
+}
+
 void PowerSessionManager::enableSystemTopAppBoost() {
     if (mHintManager) {
         ALOGV("PowerSessionManager::enableSystemTopAppBoost!!");
@@ -155,6 +250,10 @@ sp<Looper> PowerHintMonitor::getLooper() {
     return mLooper;
 }
 
+sp<StaleTimerWheel> PowerHintMonitor::getStaleTimerWheel() {
+    return mStaleTimerWheel;
+}
+
 }  // namespace pixel
 }  // namespace impl
 }  // namespace power
@@ -16,14 +16,19 @@
 
 #pragma once
 
+#include "BoostGovernor.h"
 #include "PowerHintSession.h"
+#include "StaleTimerWheel.h"
 
 #include <android-base/properties.h>
 #include <perfmgr/HintManager.h>
 #include <utils/Looper.h>
 
+#include <atomic>
+#include <array>
 #include <mutex>
 #include <optional>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace aidl {
@@ -40,6 +45,26 @@ using ::android::Thread;
 using ::android::perfmgr::HintManager;
 
 constexpr char kPowerHalAdpfDisableTopAppBoost[] = "vendor.powerhal.adpf.disable.hint";
+constexpr char kPowerHalAdpfEscalationHint[] = "vendor.powerhal.adpf.escalation.hint";
+constexpr char kPowerHalAdpfStaleWheelTick[] = "vendor.powerhal.adpf.stale_wheel.tick_ms";
+
+// Reference counts of the threads owned by hint sessions, sharded by tid so
+// that sessions with unrelated threads do not serialize on one lock. The
+// uclamp task profiles are switched under the shard lock of the tid only.
+class TidRefCountTable {
+  public:
+    void acquire(int tid);
+    void release(int tid);
+
+  private:
+    static constexpr size_t kShardCount = 16;
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<int, int> refCounts;  // protected by lock
+    };
+    Shard &getShard(int tid) { return mShards[static_cast<unsigned>(tid) % kShardCount]; }
+    std::array<Shard, kShardCount> mShards;
+};
 
 class PowerSessionManager : public MessageHandler {
   public:
@@ -49,9 +74,18 @@ class PowerSessionManager : public MessageHandler {
     // monitoring session status
     void addPowerSession(PowerHintSession *session);
     void removePowerSession(PowerHintSession *session);
+    // Sessions report when they start or stop being active and not stale.
+    void updateActiveSessionCount(bool active);
 
     void handleMessage(const Message &message) override;
     void setHintManager(std::shared_ptr<HintManager> const &hint_manager);
+    // The escalation hint goes through |governor| like PowerExt hints do.
+    void setBoostGovernor(std::shared_ptr<BoostGovernor> const &governor);
+    void updateUclampStats(uint32_t issued, uint32_t skipped);
+    // Reference counted across sessions; the escalation hint is held while
+    // any session is escalated.
+    void updateBigClusterBoost(bool enable);
+    void dumpToFd(int fd);
 
     // Singleton
     static sp<PowerSessionManager> getInstance() {
@@ -64,19 +98,36 @@ class PowerSessionManager : public MessageHandler {
     void disableSystemTopAppBoost();
     void enableSystemTopAppBoost();
     const std::string kDisableBoostHintName;
-    std::shared_ptr<HintManager> mHintManager;
+    const std::string kEscalationHintName;
+    // Serializes top-app boost changes with setting mHintManager.
+    std::mutex mTopAppBoostLock;
+    std::shared_ptr<HintManager> mHintManager;  // protected by mTopAppBoostLock
+    std::shared_ptr<HintManager> mEscalationHintManager;  // protected by mEscalationLock
+    std::shared_ptr<BoostGovernor> mBoostGovernor;
+    std::mutex mEscalationLock;
+    int mEscalationCount;  // protected by mEscalationLock
     std::unordered_set<PowerHintSession *> mSessions;  // protected by mLock
-    std::unordered_map<int, int> mTidRefCountMap;      // protected by mLock
+    TidRefCountTable mTidRefCounts;
     std::mutex mLock;
-    int mDisplayRefreshRate;
-    bool mActive;  // protected by mLock
+    std::atomic<int> mDisplayRefreshRate;
+    std::atomic<int> mActiveSessionCount;
+    std::atomic<bool> mActive;
+    std::atomic<uint64_t> mUclampSyscallsIssued;
+    std::atomic<uint64_t> mUclampSyscallsSkipped;
     // Singleton
     PowerSessionManager()
         : kDisableBoostHintName(::android::base::GetProperty(kPowerHalAdpfDisableTopAppBoost,
                                                              "ADPF_DISABLE_TA_BOOST")),
+          kEscalationHintName(::android::base::GetProperty(kPowerHalAdpfEscalationHint,
+                                                           "ADPF_BIG_CLUSTER_BOOST")),
           mHintManager(nullptr),
+          mEscalationHintManager(nullptr),
+          mEscalationCount(0),
           mDisplayRefreshRate(60),
-          mActive(false) {}
+          mActiveSessionCount(0),
+          mActive(false),
+          mUclampSyscallsIssued(0),
+          mUclampSyscallsSkipped(0) {}
     PowerSessionManager(PowerSessionManager const &) = delete;
     void operator=(PowerSessionManager const &) = delete;
 };
@@ -86,6 +137,7 @@ class PowerHintMonitor : public Thread {
     void start();
     bool threadLoop() override;
     sp<Looper> getLooper();
+    sp<StaleTimerWheel> getStaleTimerWheel();
     // Singleton
     static sp<PowerHintMonitor> getInstance() {
         static sp<PowerHintMonitor> instance = new PowerHintMonitor();
@@ -96,8 +148,14 @@ class PowerHintMonitor : public Thread {
 
   private:
     sp<Looper> mLooper;
+    sp<StaleTimerWheel> mStaleTimerWheel;
     // Singleton
-    PowerHintMonitor() : Thread(false), mLooper(new Looper(true)) {}
+    PowerHintMonitor()
+        : Thread(false),
+          mLooper(new Looper(true)),
+          mStaleTimerWheel(new StaleTimerWheel(
+                  mLooper, std::chrono::milliseconds(::android::base::GetUintProperty<uint32_t>(
+                                   kPowerHalAdpfStaleWheelTick, 10)))) {}
 };
 
 }  // namespace pixel
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include "StaleTimerWheel.h"
+
+#include <log/log.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+StaleTimerWheel::StaleTimerWheel(const sp<Looper> &looper, nanoseconds tick)
+    : mLooper(looper),
+      mTickNanos(std::max<int64_t>(tick.count(), 1)),
+      mEntryCount(0),
+      mCurrentTick(toTick(steady_clock::now())),
+      mArmedTick(-1) {}
+
+int64_t StaleTimerWheel::toTick(time_point<steady_clock> t) const {
+    // Round up so that a tick never fires before the deadline.
+    const int64_t ns = t.time_since_epoch().count();
+    return (ns + mTickNanos - 1) / mTickNanos;
+}
+
+void StaleTimerWheel::schedule(time_point<steady_clock> deadline,
+                               const sp<MessageHandler> &handler) {
+    std::lock_guard<std::mutex> guard(mLock);
+    const int64_t tick = std::max(toTick(deadline), mCurrentTick + 1);
+    mSlots[tick % kSlotCount].push_back({tick, handler});
+    mEntryCount++;
+    if (mArmedTick < 0 || tick < mArmedTick) {
+        armLocked(tick);
+    }
+}
+
+void StaleTimerWheel::cancel(const sp<MessageHandler> &handler) {
+    std::lock_guard<std::mutex> dispatchGuard(mDispatchLock);
+    std::lock_guard<std::mutex> guard(mLock);
+    for (auto &slot : mSlots) {
+        for (auto it = slot.begin(); it != slot.end();) {
+            if (it->handler == handler) {
+                it = slot.erase(it);
+                mEntryCount--;
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void StaleTimerWheel::armLocked(int64_t tick) {
+    if (mArmedTick >= 0) {
+        mLooper->removeMessages(this);
+    }
+    mArmedTick = tick;
+    const int64_t delay = tick * mTickNanos - steady_clock::now().time_since_epoch().count();
+    mLooper->sendMessageDelayed(std::max<int64_t>(delay, 0), this, Message());
+}
+
+void StaleTimerWheel::rearmLocked() {
+    if (mEntryCount == 0) {
+        return;
+    }
+    // Entries in later slots may belong to an earlier round than entries in
+    // the first non-empty one, so keep the minimum over one revolution.
+    int64_t next = INT64_MAX;
+    for (int64_t tick = mCurrentTick + 1; tick <= mCurrentTick + kSlotCount; tick++) {
+        for (const Entry &entry : mSlots[tick % kSlotCount]) {
+            next = std::min(next, entry.tick);
+        }
+        if (next == tick) {
+            break;
+        }
+    }
+    armLocked(next);
+}
+
+void StaleTimerWheel::handleMessage(const Message &message) {
+    std::lock_guard<std::mutex> dispatchGuard(mDispatchLock);
+    std::vector<sp<MessageHandler>> expired;
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mArmedTick = -1;
+        const int64_t now = steady_clock::now().time_since_epoch().count() / mTickNanos;
+        const int64_t last = std::min(now, mCurrentTick + static_cast<int64_t>(kSlotCount));
+        for (int64_t tick = mCurrentTick + 1; tick <= last; tick++) {
+            auto &slot = mSlots[tick % kSlotCount];
+            for (auto it = slot.begin(); it != slot.end();) {
+                if (it->tick <= now) {
+                    expired.push_back(std::move(it->handler));
+                    it = slot.erase(it);
+                    mEntryCount--;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        mCurrentTick = std::max(mCurrentTick, now);
+        rearmLocked();
+    }
+    ALOGV("StaleTimerWheel: %zu handlers expired", expired.size());
+    for (const auto &handler : expired) {
+        handler->handleMessage(message);
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
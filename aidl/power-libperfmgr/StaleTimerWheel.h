@@ -0,0 +1,81 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Looper.h>
+
+#include <array>
+#include <chrono>
+#include <list>
+#include <mutex>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::Looper;
+using ::android::Message;
+using ::android::MessageHandler;
+using ::android::sp;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::chrono::time_point;
+
+// Hashed timer wheel that multiplexes the stale deadlines of all hint
+// sessions onto a single looper message. Handlers are called on the looper
+// thread once their deadline has passed; a handler whose deadline moved
+// forward in the meantime is expected to schedule() itself again.
+class StaleTimerWheel : public MessageHandler {
+  public:
+    StaleTimerWheel(const sp<Looper> &looper, nanoseconds tick);
+    void schedule(time_point<steady_clock> deadline, const sp<MessageHandler> &handler);
+    // Drops all entries of |handler|. Once this returns the handler is not
+    // running and will not be called again unless rescheduled.
+    void cancel(const sp<MessageHandler> &handler);
+    void handleMessage(const Message &message) override;
+
+  private:
+    static constexpr size_t kSlotCount = 128;
+    struct Entry {
+        int64_t tick;
+        sp<MessageHandler> handler;
+    };
+    int64_t toTick(time_point<steady_clock> t) const;
+    void armLocked(int64_t tick);
+    void rearmLocked();
+    const sp<Looper> mLooper;
+    const int64_t mTickNanos;
+    std::mutex mLock;
+    std::array<std::list<Entry>, kSlotCount> mSlots;  // protected by mLock
+    size_t mEntryCount;                               // protected by mLock
+    // Last tick whose slot has been expired.
+    int64_t mCurrentTick;  // protected by mLock
+    // Tick the looper message is posted for, -1 if none.
+    int64_t mArmedTick;  // protected by mLock
+    // Held while handlers run so cancel() can wait for them.
+    std::mutex mDispatchLock;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
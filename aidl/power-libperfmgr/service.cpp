@@ -15,18 +15,29 @@
  */
 
 #define LOG_TAG "powerhal-libperfmgr"
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
 
+#include <chrono>
 #include <thread>
 
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
+#include <utils/Trace.h>
 
+#include "BoostAccounting.h"
+#include "BoostGovernor.h"
+#include "HintCoalescer.h"
+#include "ModeComposer.h"
 #include "Power.h"
 #include "PowerExt.h"
 #include "PowerSessionManager.h"
 
+using aidl::google::hardware::power::impl::pixel::BoostAccounting;
+using aidl::google::hardware::power::impl::pixel::BoostGovernor;
+using aidl::google::hardware::power::impl::pixel::HintCoalescer;
+using aidl::google::hardware::power::impl::pixel::ModeComposer;
 using aidl::google::hardware::power::impl::pixel::Power;
 using aidl::google::hardware::power::impl::pixel::PowerExt;
 using aidl::google::hardware::power::impl::pixel::PowerHintMonitor;
@@ -36,6 +47,25 @@ using ::android::perfmgr::HintManager;
 constexpr std::string_view kPowerHalInitProp("vendor.powerhal.init");
 constexpr std::string_view kConfigProperty("vendor.powerhal.config");
 constexpr std::string_view kConfigDefaultFileName("powerhint.json");
+constexpr std::string_view kBinderThreadsProperty("vendor.powerhal.binder_threads");
+
+// Traces and logs the duration of one warm start phase.
+class ScopedPhase {
+  public:
+    explicit ScopedPhase(const char *name) : mName(name), mStart(std::chrono::steady_clock::now()) {
+        ATRACE_BEGIN(name);
+    }
+    ~ScopedPhase() {
+        ATRACE_END();
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - mStart);
+        LOG(INFO) << "Warm start " << mName << " took " << elapsed.count() << "us";
+    }
+
+  private:
+    const char *const mName;
+    const std::chrono::steady_clock::time_point mStart;
+};
 
 int main() {
     const std::string config_path =
@@ -44,37 +74,68 @@ int main() {
     LOG(INFO) << "Pixel Power HAL AIDL Service with Extension is starting with config: "
               << config_path;
 
-    // Parse config but do not start the looper
-    std::shared_ptr<HintManager> hm = HintManager::GetFromJSON(config_path, false);
-    if (!hm) {
-        LOG(FATAL) << "Invalid config: " << config_path;
+    // Extra binder threads on top of the main one, so that boosts are not
+    // queued behind hint session reports.
+    const uint32_t binderThreads =
+            android::base::GetUintProperty<uint32_t>(kBinderThreadsProperty.data(), 3);
+    LOG(INFO) << "Binder thread pool max thread count: " << binderThreads;
+    ABinderProcess_setThreadPoolMaxThreadCount(binderThreads);
+    // Without starting the pool, the driver's requests for more looper
+    // threads are ignored and only the main thread below serves calls.
+    ABinderProcess_startThreadPool();
+
+    // Register right away; Power and PowerExt queue mode changes and drop
+    // boosts until the init worker below has loaded the config.
+    std::shared_ptr<Power> pw = ndk::SharedRefBase::make<Power>();
+    std::shared_ptr<PowerExt> pwExt = ndk::SharedRefBase::make<PowerExt>();
+    const bool adpfEnabled = ::android::base::GetIntProperty("vendor.powerhal.adpf.rate", -1) != -1;
+    {
+        ScopedPhase phase("register");
+        ndk::SpAIBinder pwBinder = pw->asBinder();
+
+        // attach the extension to the same binder we will be registering
+        CHECK(STATUS_OK == AIBinder_setExtension(pwBinder.get(), pwExt->asBinder().get()));
+
+        const std::string instance = std::string() + Power::descriptor + "/default";
+        binder_status_t status = AServiceManager_addService(pwBinder.get(), instance.c_str());
+        CHECK(status == STATUS_OK);
+        if (adpfEnabled) {
+            PowerHintMonitor::getInstance()->start();
+        }
     }
-
-    // single thread
-    ABinderProcess_setThreadPoolMaxThreadCount(0);
-
-    // core service
-    std::shared_ptr<Power> pw = ndk::SharedRefBase::make<Power>(hm);
-    ndk::SpAIBinder pwBinder = pw->asBinder();
-
-    // extension service
-    std::shared_ptr<PowerExt> pwExt = ndk::SharedRefBase::make<PowerExt>(hm);
-
-    // attach the extension to the same binder we will be registering
-    CHECK(STATUS_OK == AIBinder_setExtension(pwBinder.get(), pwExt->asBinder().get()));
-
-    const std::string instance = std::string() + Power::descriptor + "/default";
-    binder_status_t status = AServiceManager_addService(pw->asBinder().get(), instance.c_str());
-    CHECK(status == STATUS_OK);
     LOG(INFO) << "Pixel Power HAL AIDL Service with Extension is started.";
 
-    if (::android::base::GetIntProperty("vendor.powerhal.adpf.rate", -1) != -1) {
-        PowerHintMonitor::getInstance()->start();
-        PowerSessionManager::getInstance()->setHintManager(hm);
-    }
+    std::thread initThread([pw, pwExt, config_path, adpfEnabled]() {
+        std::shared_ptr<HintManager> hm;
+        std::shared_ptr<ModeComposer> mc;
+        std::shared_ptr<BoostGovernor> bg;
+        std::shared_ptr<BoostAccounting> ba;
+        {
+            // Parse config but do not start the looper
+            ScopedPhase phase("parse");
+            hm = HintManager::GetFromJSON(config_path, false);
+            if (!hm) {
+                LOG(FATAL) << "Invalid config: " << config_path;
+            }
+            mc = ModeComposer::GetFromJSON(config_path, hm);
+            bg = BoostGovernor::GetFromJSON(config_path);
+            ba = BoostAccounting::GetFromJSON(config_path);
+        }
+        {
+            ScopedPhase phase("replay");
+            // Shared by Power and PowerExt so that both see the same hint state.
+            std::shared_ptr<HintCoalescer> hc = std::make_shared<HintCoalescer>(hm);
+            if (adpfEnabled) {
+                PowerSessionManager::getInstance()->setHintManager(hm);
+                PowerSessionManager::getInstance()->setBoostGovernor(bg);
+            }
+            pwExt->Init(hm, hc, bg, ba);
+            pw->Init(hm, mc, hc, pwExt);
+        }
 
-    std::thread initThread([&]() {
         ::android::base::WaitForProperty(kPowerHalInitProp.data(), "1");
+        // Nodes are opened and validated here, once their owners are up.
+        ScopedPhase phase("start");
         hm->Start();
     });
     initThread.detach();
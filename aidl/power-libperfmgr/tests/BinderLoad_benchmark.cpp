@@ -0,0 +1,145 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <aidl/android/hardware/power/IPower.h>
+#include <android/binder_manager.h>
+#include <benchmark/benchmark.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using aidl::android::hardware::power::Boost;
+using aidl::android::hardware::power::IPower;
+using aidl::android::hardware::power::IPowerHintSession;
+using aidl::android::hardware::power::WorkDuration;
+using std::chrono::steady_clock;
+
+namespace {
+
+constexpr char kInstance[] = "android.hardware.power.IPower/default";
+constexpr std::chrono::nanoseconds kFramePeriod(1000000000LL / 120);
+// Gap between boosts, so that they do not queue behind each other.
+constexpr std::chrono::milliseconds kBoostInterval(2);
+
+std::shared_ptr<IPower> getPower() {
+    ndk::SpAIBinder binder(AServiceManager_waitForService(kInstance));
+    return IPower::fromBinder(binder);
+}
+
+// Hint sessions created through the service, each on its own thread reporting
+// one frame every 120 Hz vsync, like a game's render threads.
+class SessionLoad {
+  public:
+    SessionLoad(const std::shared_ptr<IPower> &power, int sessions)
+        : mStop(false), mFailed(false) {
+        for (int i = 0; i < sessions; ++i) {
+            mThreads.emplace_back([this, power, i] { run(power, i); });
+        }
+    }
+
+    ~SessionLoad() {
+        mStop = true;
+        for (auto &thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    bool failed() const { return mFailed; }
+
+  private:
+    void run(const std::shared_ptr<IPower> &power, int index) {
+        std::shared_ptr<IPowerHintSession> session;
+        if (!power->createHintSession(getpid(), getuid(), {gettid()}, kFramePeriod.count(),
+                                      &session)
+                     .isOk() ||
+            session == nullptr) {
+            mFailed = true;
+            return;
+        }
+        std::vector<WorkDuration> report(1);
+        auto next = steady_clock::now();
+        for (int frame = 0; !mStop; ++frame) {
+            next += kFramePeriod;
+            std::this_thread::sleep_until(next);
+            // 70% to 130% of the budget.
+            report[0].timeStampNanos = next.time_since_epoch().count();
+            report[0].durationNanos =
+                    kFramePeriod.count() * (70 + (frame * 7 + index * 13) % 61) / 100;
+            session->reportActualWorkDuration(report);
+        }
+        session->close();
+    }
+
+    std::atomic<bool> mStop;
+    std::atomic<bool> mFailed;
+    std::vector<std::thread> mThreads;
+};
+
+// Round trip of setBoost(INTERACTION) to the running service, with
+// |sessions| hint sessions reporting at 120 Hz at the same time.
+void BM_SetBoostInteraction(benchmark::State &state) {
+    const std::shared_ptr<IPower> power = getPower();
+    if (power == nullptr) {
+        state.SkipWithError("Power HAL not found");
+        return;
+    }
+    int64_t rate;
+    const int sessions = state.range(0);
+    if (sessions > 0 && !power->getHintSessionPreferredRate(&rate).isOk()) {
+        state.SkipWithError("Hint sessions are disabled, set vendor.powerhal.adpf.rate");
+        return;
+    }
+    SessionLoad load(power, sessions);
+
+    std::vector<int64_t> latenciesNs;
+    latenciesNs.reserve(state.max_iterations);
+    for (auto _ : state) {
+        const auto start = steady_clock::now();
+        power->setBoost(Boost::INTERACTION, 0);
+        const auto elapsed = steady_clock::now() - start;
+        state.SetIterationTime(std::chrono::duration<double>(elapsed).count());
+        latenciesNs.push_back(std::chrono::nanoseconds(elapsed).count());
+        std::this_thread::sleep_for(kBoostInterval);
+    }
+    if (load.failed()) {
+        state.SkipWithError("Failed to create a hint session");
+        return;
+    }
+
+    std::sort(latenciesNs.begin(), latenciesNs.end());
+    auto percentileUs = [&latenciesNs](size_t percentile) {
+        return latenciesNs[(latenciesNs.size() - 1) * percentile / 100] / 1000.0;
+    };
+    state.counters["p50_us"] = percentileUs(50);
+    state.counters["p99_us"] = percentileUs(99);
+    state.counters["max_us"] = latenciesNs.back() / 1000.0;
+}
+
+BENCHMARK(BM_SetBoostInteraction)
+        ->Arg(0)
+        ->Arg(8)
+        ->ArgName("sessions")
+        ->Iterations(5000)
+        ->UseManualTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
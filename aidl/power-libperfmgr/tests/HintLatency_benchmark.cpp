@@ -0,0 +1,366 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <json/json.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "BoostAccounting.h"
+#include "BoostGovernor.h"
+#include "HintCoalescer.h"
+#include "ModeComposer.h"
+#include "Power.h"
+#include "PowerExt.h"
+#include "PowerHintSession.h"
+#include "PowerSessionManager.h"
+
+using aidl::android::hardware::power::Boost;
+using aidl::android::hardware::power::Mode;
+using aidl::android::hardware::power::WorkDuration;
+using aidl::google::hardware::power::impl::pixel::BoostAccounting;
+using aidl::google::hardware::power::impl::pixel::BoostGovernor;
+using aidl::google::hardware::power::impl::pixel::HintCoalescer;
+using aidl::google::hardware::power::impl::pixel::ModeComposer;
+using aidl::google::hardware::power::impl::pixel::Power;
+using aidl::google::hardware::power::impl::pixel::PowerExt;
+using aidl::google::hardware::power::impl::pixel::PowerHintMonitor;
+using aidl::google::hardware::power::impl::pixel::PowerHintSession;
+using aidl::google::hardware::power::impl::pixel::PowerSessionManager;
+using ::android::perfmgr::HintManager;
+using std::chrono::steady_clock;
+
+namespace {
+
+constexpr char kConfigProperty[] = "vendor.powerhal.config";
+constexpr char kConfigDefaultFileName[] = "powerhint.json";
+constexpr std::chrono::nanoseconds kFramePeriod(1000000000LL / 120);
+// Five seconds of frames per run.
+constexpr int kFrames = 600;
+constexpr int kGameSessions = 4;
+
+bool makeDirs(const std::string &path) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos;
+         slash = path.find('/', slash + 1)) {
+        if (mkdir(path.substr(0, slash).c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The service's config with every node, including property nodes, and the
+// governor's thermal and battery readings moved to plain files in a temporary
+// directory, so that hints never touch the real sysfs or system properties.
+class FakeSysfs {
+  public:
+    bool Init(const std::string &realConfigPath, std::string *error) {
+        std::string json_doc;
+        Json::Value root;
+        Json::Reader reader;
+        if (!::android::base::ReadFileToString(realConfigPath, &json_doc) ||
+            !reader.parse(json_doc, root)) {
+            *error = "Failed to read " + realConfigPath;
+            return false;
+        }
+        Json::Value &nodes = root["Nodes"];
+        for (Json::ArrayIndex i = 0; i < nodes.size(); i++) {
+            Json::Value &node = nodes[i];
+            const Json::Value &values = node["Values"];
+            // libperfmgr defaults to the last value.
+            const Json::ArrayIndex defaultIndex = node["DefaultIndex"].isUInt()
+                                                          ? node["DefaultIndex"].asUInt()
+                                                          : values.size() - 1;
+            // Property nodes are names, not paths; keep them apart from sysfs.
+            const std::string prefix = node["Type"].asString() == "Property" ? "props/" : "";
+            node["Type"] = "File";
+            node["Path"] = fake(prefix + node["Path"].asString());
+            if (!write(node["Path"].asString(), values[defaultIndex].asString())) {
+                *error = "Failed to create " + node["Path"].asString();
+                return false;
+            }
+            mNodePaths.push_back(node["Path"].asString());
+        }
+        Json::Value &governor = root["BoostGovernor"];
+        if (governor.isObject()) {
+            // Cool and charged, so that no policy fires.
+            governor["ThermalPath"] = fake("/thermal/temp");
+            governor["BatteryPath"] = fake("/battery/capacity");
+            if (!write(governor["ThermalPath"].asString(), "35000") ||
+                !write(governor["BatteryPath"].asString(), "80")) {
+                *error = "Failed to create the governor readings";
+                return false;
+            }
+        }
+        mConfigPath = std::string(mDir.path) + "/" + kConfigDefaultFileName;
+        if (!::android::base::WriteStringToFile(
+                    Json::writeString(Json::StreamWriterBuilder(), root), mConfigPath)) {
+            *error = "Failed to write " + mConfigPath;
+            return false;
+        }
+        return true;
+    }
+
+    const std::string &configPath() const { return mConfigPath; }
+    const std::vector<std::string> &nodePaths() const { return mNodePaths; }
+
+  private:
+    std::string fake(const std::string &path) const {
+        const std::string dir(mDir.path);
+        return path.empty() || path[0] != '/' ? dir + "/" + path : dir + path;
+    }
+
+    static bool write(const std::string &path, const std::string &value) {
+        return makeDirs(path) && ::android::base::WriteStringToFile(value, path);
+    }
+
+    TemporaryDir mDir;
+    std::string mConfigPath;
+    std::vector<std::string> mNodePaths;
+};
+
+// Power, PowerExt and the session manager wired up as service.cpp does, on
+// top of a FakeSysfs. Built once and shared by all runs.
+struct FakeHal {
+    FakeSysfs sysfs;
+    std::shared_ptr<Power> power;
+    std::shared_ptr<PowerExt> ext;
+    std::string error;
+};
+
+FakeHal *getFakeHal() {
+    static FakeHal *hal = [] {
+        FakeHal *hal = new FakeHal();
+        const std::string realConfigPath =
+                "/vendor/etc/" +
+                ::android::base::GetProperty(kConfigProperty, kConfigDefaultFileName);
+        if (!hal->sysfs.Init(realConfigPath, &hal->error)) {
+            return hal;
+        }
+        const std::string &configPath = hal->sysfs.configPath();
+        std::shared_ptr<HintManager> hm = HintManager::GetFromJSON(configPath, false);
+        if (!hm) {
+            hal->error = "Invalid config: " + configPath;
+            return hal;
+        }
+        std::shared_ptr<ModeComposer> mc = ModeComposer::GetFromJSON(configPath, hm);
+        std::shared_ptr<BoostGovernor> bg = BoostGovernor::GetFromJSON(configPath);
+        std::shared_ptr<BoostAccounting> ba = BoostAccounting::GetFromJSON(configPath);
+        std::shared_ptr<HintCoalescer> hc = std::make_shared<HintCoalescer>(hm);
+        PowerSessionManager::getInstance()->setHintManager(hm);
+        PowerSessionManager::getInstance()->setBoostGovernor(bg);
+        PowerHintMonitor::getInstance()->start();
+        hal->ext = ndk::SharedRefBase::make<PowerExt>();
+        hal->power = ndk::SharedRefBase::make<Power>();
+        hal->ext->Init(hm, hc, bg, ba);
+        hal->power->Init(hm, mc, hc, hal->ext);
+        hm->Start();
+        return hal;
+    }();
+    return hal;
+}
+
+// Syscall counters of this process, including the libperfmgr looper thread
+// that does the node writes.
+struct SyscallCounts {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+};
+
+SyscallCounts readSyscallCounts() {
+    SyscallCounts counts;
+    std::string io;
+    ::android::base::ReadFileToString("/proc/self/io", &io);
+    const size_t syscr = io.find("syscr:");
+    const size_t syscw = io.find("syscw:");
+    if (syscr != std::string::npos && syscw != std::string::npos) {
+        sscanf(io.c_str() + syscr, "syscr: %" SCNu64, &counts.reads);
+        sscanf(io.c_str() + syscw, "syscw: %" SCNu64, &counts.writes);
+    }
+    return counts;
+}
+
+enum Mix : int64_t {
+    // An app launch every 500ms: touch boost, LAUNCH mode for 250ms and a
+    // vendor launch boost through the extension.
+    LAUNCH = 0,
+    // A fling: a touch boost every 50ms and a display update every frame.
+    SCROLL = 1,
+    // kGameSessions render threads reporting every frame.
+    GAME = 2,
+};
+
+void runFrame(Mix mix, int frame, FakeHal *hal,
+              const std::vector<std::shared_ptr<PowerHintSession>> &sessions,
+              const std::function<void(const std::function<void()> &)> &call) {
+    switch (mix) {
+        case LAUNCH:
+            if (frame % 60 == 0) {
+                call([hal] { hal->power->setBoost(Boost::INTERACTION, 0); });
+                call([hal] { hal->power->setMode(Mode::LAUNCH, true); });
+                call([hal] { hal->ext->setBoost("LAUNCH", 500); });
+            } else if (frame % 60 == 30) {
+                call([hal] { hal->power->setMode(Mode::LAUNCH, false); });
+            }
+            break;
+        case SCROLL:
+            if (frame % 6 == 0) {
+                call([hal] { hal->power->setBoost(Boost::INTERACTION, 0); });
+            }
+            call([hal] { hal->power->setBoost(Boost::DISPLAY_UPDATE_IMMINENT, 0); });
+            break;
+        case GAME:
+            for (size_t i = 0; i < sessions.size(); ++i) {
+                WorkDuration duration;
+                duration.timeStampNanos = frame * kFramePeriod.count();
+                // 70% to 130% of the budget.
+                duration.durationNanos =
+                        kFramePeriod.count() * (70 + (frame * 7 + i * 13) % 61) / 100;
+                const std::vector<WorkDuration> report = {duration};
+                call([&sessions, i, &report] { sessions[i]->reportActualWorkDuration(report); });
+            }
+            break;
+    }
+}
+
+// Paces |mix| at 120 Hz and times each HAL call. With inotify set, it also
+// reports the time from the latest call to each node write seen by an inotify
+// watch on the fake nodes, which is when the libperfmgr looper got to it.
+void BM_HintLatency(benchmark::State &state) {
+    FakeHal *hal = getFakeHal();
+    if (!hal->error.empty()) {
+        state.SkipWithError(hal->error.c_str());
+        return;
+    }
+    const Mix mix = static_cast<Mix>(state.range(0));
+    const bool watchWrites = state.range(1);
+
+    ::android::base::unique_fd inotifyFd;
+    if (watchWrites) {
+        inotifyFd.reset(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+        for (const std::string &path : hal->sysfs.nodePaths()) {
+            inotify_add_watch(inotifyFd.get(), path.c_str(), IN_MODIFY);
+        }
+    }
+    std::vector<std::shared_ptr<PowerHintSession>> sessions;
+    if (mix == GAME) {
+        for (int i = 0; i < kGameSessions; ++i) {
+            sessions.push_back(ndk::SharedRefBase::make<PowerHintSession>(
+                    getpid(), getuid(), std::vector<int32_t>{gettid()}, kFramePeriod.count(),
+                    kFramePeriod));
+        }
+    }
+
+    std::vector<int64_t> callNs;
+    std::vector<int64_t> writeNs;
+    const SyscallCounts before = readSyscallCounts();
+    auto nextFrame = steady_clock::now();
+    // Start of the latest call, which node writes are attributed to.
+    steady_clock::time_point lastCall;
+    int frame = 0;
+    for (auto _ : state) {
+        steady_clock::duration frameTime(0);
+        runFrame(mix, frame++, hal, sessions, [&](const std::function<void()> &fn) {
+            lastCall = steady_clock::now();
+            fn();
+            const auto elapsed = steady_clock::now() - lastCall;
+            frameTime += elapsed;
+            callNs.push_back(std::chrono::nanoseconds(elapsed).count());
+        });
+        state.SetIterationTime(std::chrono::duration<double>(frameTime).count());
+
+        nextFrame += kFramePeriod;
+        while (watchWrites && steady_clock::now() < nextFrame) {
+            const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    nextFrame - steady_clock::now());
+            pollfd pfd = {inotifyFd.get(), POLLIN, 0};
+            if (poll(&pfd, 1, std::max<int>(1, timeout.count())) <= 0) {
+                continue;
+            }
+            const auto now = steady_clock::now();
+            alignas(inotify_event) char buf[4096];
+            for (ssize_t len; (len = read(inotifyFd.get(), buf, sizeof(buf))) > 0;) {
+                for (char *p = buf; p < buf + len;) {
+                    const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+                    if ((event->mask & IN_MODIFY) && lastCall != steady_clock::time_point()) {
+                        writeNs.push_back(std::chrono::nanoseconds(now - lastCall).count());
+                    }
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+        std::this_thread::sleep_until(nextFrame);
+    }
+    const SyscallCounts after = readSyscallCounts();
+    for (const auto &session : sessions) {
+        session->close();
+    }
+
+    if (callNs.empty()) {
+        return;
+    }
+    auto percentileUs = [](std::vector<int64_t> *ns, size_t percentile) {
+        std::sort(ns->begin(), ns->end());
+        return (*ns)[(ns->size() - 1) * percentile / 100] / 1000.0;
+    };
+    const double calls = callNs.size();
+    state.counters["calls"] = calls;
+    state.counters["call_p50_us"] = percentileUs(&callNs, 50);
+    state.counters["call_p90_us"] = percentileUs(&callNs, 90);
+    state.counters["call_p99_us"] = percentileUs(&callNs, 99);
+    state.counters["call_max_us"] = callNs.back() / 1000.0;
+    state.counters["syscr_per_call"] = (after.reads - before.reads) / calls;
+    state.counters["syscw_per_call"] = (after.writes - before.writes) / calls;
+    if (watchWrites) {
+        state.counters["node_writes"] = writeNs.size();
+        if (!writeNs.empty()) {
+            state.counters["write_p50_us"] = percentileUs(&writeNs, 50);
+            state.counters["write_p99_us"] = percentileUs(&writeNs, 99);
+        }
+    }
+}
+
+void hintLatencyArgs(benchmark::internal::Benchmark *b) {
+    for (int64_t mix : {LAUNCH, SCROLL, GAME}) {
+        for (int64_t watchWrites : {0, 1}) {
+            b->Args({mix, watchWrites});
+        }
+    }
+    b->ArgNames({"mix", "inotify"});
+}
+
+BENCHMARK(BM_HintLatency)->Apply(hintLatencyArgs)->Iterations(kFrames)->UseManualTime();
+
+}  // namespace
+
+// main() comes from PowerHintSession_benchmark.cpp.
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
+
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+#include <cutils/trace.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <cinttypes>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "PowerHintSession.h"
+#include "PowerSessionManager.h"
+
+using aidl::android::hardware::power::WorkDuration;
+using aidl::google::hardware::power::impl::pixel::PowerHintMonitor;
+using aidl::google::hardware::power::impl::pixel::PowerHintSession;
+
+namespace {
+
+// Allocations made by the current thread; replacing the global operator new
+// counts them for everything in this binary, including libraries.
+thread_local uint64_t tAllocations = 0;
+
+}  // namespace
+
+void *operator new(size_t size) {
+    tAllocations++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        abort();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+namespace {
+
+constexpr char kTraceTagsProperty[] = "debug.atrace.tags.enableflags";
+constexpr int64_t kFrameNanos = 1000000000LL / 120;
+// Distinct reports cycled through, so the PID sees both overruns and slack.
+constexpr size_t kReports = 64;
+
+// Turns the power HAL trace tags on or off for this process, restoring the
+// previous tags on destruction. Needs root to set the property.
+class ScopedTracing {
+  public:
+    explicit ScopedTracing(bool enabled)
+        : mSavedTags(::android::base::GetProperty(kTraceTagsProperty, "0")) {
+        // Makes sure the trace state is initialized before updating it.
+        atrace_get_enabled_tags();
+        set(enabled ? ::android::base::StringPrintf("%#" PRIx64, static_cast<uint64_t>(ATRACE_TAG))
+                    : "0");
+    }
+    ~ScopedTracing() { set(mSavedTags); }
+
+  private:
+    static void set(const std::string &tags) {
+        ::android::base::SetProperty(kTraceTagsProperty, tags);
+        atrace_update_tags();
+    }
+    const std::string mSavedTags;
+};
+
+// Reports of |batch| frames each, around a 120 Hz frame budget.
+std::vector<std::vector<WorkDuration>> makeReports(size_t batch) {
+    std::vector<std::vector<WorkDuration>> reports(kReports);
+    int64_t timestamp = 0;
+    for (size_t i = 0; i < kReports; ++i) {
+        for (size_t j = 0; j < batch; ++j) {
+            WorkDuration duration;
+            timestamp += kFrameNanos;
+            duration.timeStampNanos = timestamp;
+            // 70% to 130% of the budget.
+            duration.durationNanos = kFrameNanos * (70 + (i * 7 + j * 13) % 61) / 100;
+            reports[i].push_back(duration);
+        }
+    }
+    return reports;
+}
+
+// One reportActualWorkDuration() call per iteration, as a binder thread runs
+// it for an app reporting at 120 Hz; the counter is allocations per call.
+void BM_ReportActualWorkDuration(benchmark::State &state) {
+    const bool tracing = state.range(0);
+    const size_t batch = state.range(1);
+    ScopedTracing scopedTracing(tracing);
+    if (tracing != (ATRACE_ENABLED() != 0)) {
+        state.SkipWithError("Failed to switch tracing, run as root");
+        return;
+    }
+    PowerHintMonitor::getInstance()->start();
+    std::shared_ptr<PowerHintSession> session = ndk::SharedRefBase::make<PowerHintSession>(
+            getpid(), getuid(), std::vector<int32_t>{gettid()}, kFrameNanos,
+            std::chrono::nanoseconds(kFrameNanos));
+    const std::vector<std::vector<WorkDuration>> reports = makeReports(batch);
+
+    size_t next = 0;
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        const uint64_t before = tAllocations;
+        session->reportActualWorkDuration(reports[next]);
+        allocations += tAllocations - before;
+        next = (next + 1) % kReports;
+    }
+    session->close();
+    state.counters["allocs_per_call"] =
+            benchmark::Counter(allocations, benchmark::Counter::kAvgIterations);
+}
+
+void reportArgs(benchmark::internal::Benchmark *b) {
+    for (int64_t tracing : {0, 1}) {
+        for (int64_t batch : {1, 4}) {
+            b->Args({tracing, batch});
+        }
+    }
+    b->ArgNames({"tracing", "batch"});
+}
+
+BENCHMARK(BM_ReportActualWorkDuration)->Apply(reportArgs);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -18,6 +18,17 @@
 #include <android-base/logging.h>
 #include <log/log.h>
 
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using AidlSensorInfo = ::aidl::android::hardware::sensors::SensorInfo;
 using AidlSensorType = ::aidl::android::hardware::sensors::SensorType;
 using AidlEvent = ::aidl::android::hardware::sensors::Event;
@@ -26,6 +37,9 @@ using ::aidl::android::hardware::sensors::AdditionalInfo;
 using ::aidl::android::hardware::sensors::DynamicSensorInfo;
 using ::android::hardware::sensors::V1_0::MetaDataEventType;
 using V1_0SensorStatus = ::android::hardware::sensors::V1_0::SensorStatus;
+using V1_0Uncal = ::android::hardware::sensors::V1_0::Uncal;
+using V1_0Vec3 = ::android::hardware::sensors::V1_0::Vec3;
+using V1_0Vec4 = ::android::hardware::sensors::V1_0::Vec4;
 using ::android::hardware::sensors::V1_0::AdditionalInfoType;
 using V2_1SensorInfo = ::android::hardware::sensors::V2_1::SensorInfo;
 using V2_1Event = ::android::hardware::sensors::V2_1::Event;
@@ -57,302 +71,481 @@ AidlSensorInfo convertSensorInfo(const V2_1SensorInfo& sensorInfo) {
     return aidlSensorInfo;
 }
 
-void convertToHidlEvent(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
-    static_assert(decltype(hidlEvent->u.data)::elementCount() == 16);
+namespace {
+
+// Payload layouts shared by groups of sensor types. Conversion looks the
+// layout up once per event (or once per run of same-typed events) instead of
+// switching over every sensor type.
+enum class PayloadKind : uint8_t {
+    INVALID = 0,
+    META,
+    VEC3,
+    VEC4,
+    ROTATION,
+    UNCAL,
+    SCALAR,
+    STEP_COUNT,
+    HEART_RATE,
+    POSE_6DOF,
+    DYNAMIC,
+    ADDITIONAL,
+    HEAD_TRACKER,
+    DATA,
+    COUNT,
+};
+
+// Covers every public sensor type; device private types all use DATA.
+constexpr size_t kKindTableSize = 64;
+
+constexpr std::array<PayloadKind, kKindTableSize> makeKindTable() {
+    std::array<PayloadKind, kKindTableSize> table{};
+    auto set = [&table](AidlSensorType type, PayloadKind kind) {
+        table[static_cast<size_t>(type)] = kind;
+    };
+    set(AidlSensorType::META_DATA, PayloadKind::META);
+    set(AidlSensorType::ACCELEROMETER, PayloadKind::VEC3);
+    set(AidlSensorType::MAGNETIC_FIELD, PayloadKind::VEC3);
+    set(AidlSensorType::ORIENTATION, PayloadKind::VEC3);
+    set(AidlSensorType::GYROSCOPE, PayloadKind::VEC3);
+    set(AidlSensorType::GRAVITY, PayloadKind::VEC3);
+    set(AidlSensorType::LINEAR_ACCELERATION, PayloadKind::VEC3);
+    set(AidlSensorType::GAME_ROTATION_VECTOR, PayloadKind::VEC4);
+    set(AidlSensorType::ROTATION_VECTOR, PayloadKind::ROTATION);
+    set(AidlSensorType::GEOMAGNETIC_ROTATION_VECTOR, PayloadKind::ROTATION);
+    set(AidlSensorType::ACCELEROMETER_UNCALIBRATED, PayloadKind::UNCAL);
+    set(AidlSensorType::MAGNETIC_FIELD_UNCALIBRATED, PayloadKind::UNCAL);
+    set(AidlSensorType::GYROSCOPE_UNCALIBRATED, PayloadKind::UNCAL);
+    set(AidlSensorType::DEVICE_ORIENTATION, PayloadKind::SCALAR);
+    set(AidlSensorType::LIGHT, PayloadKind::SCALAR);
+    set(AidlSensorType::PRESSURE, PayloadKind::SCALAR);
+    set(AidlSensorType::PROXIMITY, PayloadKind::SCALAR);
+    set(AidlSensorType::RELATIVE_HUMIDITY, PayloadKind::SCALAR);
+    set(AidlSensorType::AMBIENT_TEMPERATURE, PayloadKind::SCALAR);
+    set(AidlSensorType::SIGNIFICANT_MOTION, PayloadKind::SCALAR);
+    set(AidlSensorType::STEP_DETECTOR, PayloadKind::SCALAR);
+    set(AidlSensorType::TILT_DETECTOR, PayloadKind::SCALAR);
+    set(AidlSensorType::WAKE_GESTURE, PayloadKind::SCALAR);
+    set(AidlSensorType::GLANCE_GESTURE, PayloadKind::SCALAR);
+    set(AidlSensorType::PICK_UP_GESTURE, PayloadKind::SCALAR);
+    set(AidlSensorType::WRIST_TILT_GESTURE, PayloadKind::SCALAR);
+    set(AidlSensorType::STATIONARY_DETECT, PayloadKind::SCALAR);
+    set(AidlSensorType::MOTION_DETECT, PayloadKind::SCALAR);
+    set(AidlSensorType::HEART_BEAT, PayloadKind::SCALAR);
+    set(AidlSensorType::LOW_LATENCY_OFFBODY_DETECT, PayloadKind::SCALAR);
+    set(AidlSensorType::HINGE_ANGLE, PayloadKind::SCALAR);
+    set(AidlSensorType::STEP_COUNTER, PayloadKind::STEP_COUNT);
+    set(AidlSensorType::HEART_RATE, PayloadKind::HEART_RATE);
+    set(AidlSensorType::POSE_6DOF, PayloadKind::POSE_6DOF);
+    set(AidlSensorType::DYNAMIC_SENSOR_META, PayloadKind::DYNAMIC);
+    set(AidlSensorType::ADDITIONAL_INFO, PayloadKind::ADDITIONAL);
+    set(AidlSensorType::HEAD_TRACKER, PayloadKind::HEAD_TRACKER);
+    return table;
+}
+
+constexpr std::array<PayloadKind, kKindTableSize> kKindTable = makeKindTable();
+
+inline PayloadKind payloadKind(int32_t sensorType) {
+    if (sensorType >= static_cast<int32_t>(AidlSensorType::DEVICE_PRIVATE_BASE)) {
+        return PayloadKind::DATA;
+    }
+    if (sensorType < 0 || static_cast<size_t>(sensorType) >= kKindTableSize) {
+        return PayloadKind::INVALID;
+    }
+    return kKindTable[sensorType];
+}
+
+// Payload structs that are copied between the HIDL and AIDL events as raw
+// bytes, whole structs at a time.
+template <typename HidlT, typename AidlT>
+struct RawLayout {
+    static_assert(sizeof(HidlT) == sizeof(AidlT));
+    static_assert(std::is_trivially_copyable_v<HidlT> && std::is_trivially_copyable_v<AidlT>);
+    static constexpr size_t kBytes = sizeof(HidlT);
+};
+using Vec3Layout = RawLayout<V1_0Vec3, AidlEvent::EventPayload::Vec3>;
+using Vec4Layout = RawLayout<V1_0Vec4, AidlEvent::EventPayload::Vec4>;
+using UncalLayout = RawLayout<V1_0Uncal, AidlEvent::EventPayload::Uncal>;
+// Vec3 (three floats and a status byte) and Vec4 each move as a single
+// vector register, Uncal (six floats) as one register and a tail.
+static_assert(Vec3Layout::kBytes == 16 && Vec4Layout::kBytes == 16);
+static_assert(UncalLayout::kBytes == 24);
+
+// A byte copy is only a conversion if both sides put the same field at the
+// same offset, and the status byte means the same thing on both sides.
+#define ASSERT_SAME_OFFSET(HidlT, hidlField, AidlT, aidlField, offset) \
+    static_assert(offsetof(HidlT, hidlField) == (offset) &&            \
+                  offsetof(AidlT, aidlField) == (offset))
+ASSERT_SAME_OFFSET(V1_0Vec3, x, AidlEvent::EventPayload::Vec3, x, 0);
+ASSERT_SAME_OFFSET(V1_0Vec3, y, AidlEvent::EventPayload::Vec3, y, 4);
+ASSERT_SAME_OFFSET(V1_0Vec3, z, AidlEvent::EventPayload::Vec3, z, 8);
+ASSERT_SAME_OFFSET(V1_0Vec3, status, AidlEvent::EventPayload::Vec3, status, 12);
+ASSERT_SAME_OFFSET(V1_0Vec4, x, AidlEvent::EventPayload::Vec4, x, 0);
+ASSERT_SAME_OFFSET(V1_0Vec4, y, AidlEvent::EventPayload::Vec4, y, 4);
+ASSERT_SAME_OFFSET(V1_0Vec4, z, AidlEvent::EventPayload::Vec4, z, 8);
+ASSERT_SAME_OFFSET(V1_0Vec4, w, AidlEvent::EventPayload::Vec4, w, 12);
+ASSERT_SAME_OFFSET(V1_0Uncal, x, AidlEvent::EventPayload::Uncal, x, 0);
+ASSERT_SAME_OFFSET(V1_0Uncal, y, AidlEvent::EventPayload::Uncal, y, 4);
+ASSERT_SAME_OFFSET(V1_0Uncal, z, AidlEvent::EventPayload::Uncal, z, 8);
+ASSERT_SAME_OFFSET(V1_0Uncal, x_bias, AidlEvent::EventPayload::Uncal, xBias, 12);
+ASSERT_SAME_OFFSET(V1_0Uncal, y_bias, AidlEvent::EventPayload::Uncal, yBias, 16);
+ASSERT_SAME_OFFSET(V1_0Uncal, z_bias, AidlEvent::EventPayload::Uncal, zBias, 20);
+#undef ASSERT_SAME_OFFSET
+
+static_assert(sizeof(V1_0SensorStatus) == 1 && sizeof(AidlSensorStatus) == 1);
+#define ASSERT_SAME_STATUS(status)                                 \
+    static_assert(static_cast<int8_t>(V1_0SensorStatus::status) == \
+                  static_cast<int8_t>(AidlSensorStatus::status))
+ASSERT_SAME_STATUS(NO_CONTACT);
+ASSERT_SAME_STATUS(UNRELIABLE);
+ASSERT_SAME_STATUS(ACCURACY_LOW);
+ASSERT_SAME_STATUS(ACCURACY_MEDIUM);
+ASSERT_SAME_STATUS(ACCURACY_HIGH);
+#undef ASSERT_SAME_STATUS
+
+inline void copy16(void* dst, const void* src) {
+#if defined(__ARM_NEON)
+    vst1q_u8(static_cast<uint8_t*>(dst), vld1q_u8(static_cast<const uint8_t*>(src)));
+#elif defined(__SSE2__)
+    _mm_storeu_si128(static_cast<__m128i*>(dst),
+                     _mm_loadu_si128(static_cast<const __m128i*>(src)));
+#else
+    memcpy(dst, src, 16);
+#endif
+}
+
+template <typename Layout>
+inline void copyPayload(void* dst, const void* src) {
+    static_assert(Layout::kBytes == 16 || Layout::kBytes == 24);
+    copy16(dst, src);
+    if constexpr (Layout::kBytes == 24) {
+        memcpy(static_cast<uint8_t*>(dst) + 16, static_cast<const uint8_t*>(src) + 16, 8);
+    }
+}
+
+constexpr size_t kRotationVectorValues = 5;
+
+inline void toHidlHeader(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
     hidlEvent->timestamp = aidlEvent.timestamp;
     hidlEvent->sensorHandle = aidlEvent.sensorHandle;
     hidlEvent->sensorType = (V2_1SensorType)aidlEvent.sensorType;
+}
 
-    switch (aidlEvent.sensorType) {
-        case AidlSensorType::META_DATA:
-            hidlEvent->u.meta.what =
-                    (MetaDataEventType)aidlEvent.payload.get<Event::EventPayload::meta>().what;
-            break;
-        case AidlSensorType::ACCELEROMETER:
-        case AidlSensorType::MAGNETIC_FIELD:
-        case AidlSensorType::ORIENTATION:
-        case AidlSensorType::GYROSCOPE:
-        case AidlSensorType::GRAVITY:
-        case AidlSensorType::LINEAR_ACCELERATION:
-            hidlEvent->u.vec3.x = aidlEvent.payload.get<Event::EventPayload::vec3>().x;
-            hidlEvent->u.vec3.y = aidlEvent.payload.get<Event::EventPayload::vec3>().y;
-            hidlEvent->u.vec3.z = aidlEvent.payload.get<Event::EventPayload::vec3>().z;
-            hidlEvent->u.vec3.status =
-                    (V1_0SensorStatus)aidlEvent.payload.get<Event::EventPayload::vec3>().status;
-            break;
-        case AidlSensorType::GAME_ROTATION_VECTOR:
-            hidlEvent->u.vec4.x = aidlEvent.payload.get<Event::EventPayload::vec4>().x;
-            hidlEvent->u.vec4.y = aidlEvent.payload.get<Event::EventPayload::vec4>().y;
-            hidlEvent->u.vec4.z = aidlEvent.payload.get<Event::EventPayload::vec4>().z;
-            hidlEvent->u.vec4.w = aidlEvent.payload.get<Event::EventPayload::vec4>().w;
-            break;
-        case AidlSensorType::ROTATION_VECTOR:
-        case AidlSensorType::GEOMAGNETIC_ROTATION_VECTOR:
-            std::copy(aidlEvent.payload.get<Event::EventPayload::data>().values.data(),
-                      aidlEvent.payload.get<Event::EventPayload::data>().values.data() + 5,
-                      hidlEvent->u.data.data());
-            break;
-        case AidlSensorType::ACCELEROMETER_UNCALIBRATED:
-        case AidlSensorType::MAGNETIC_FIELD_UNCALIBRATED:
-        case AidlSensorType::GYROSCOPE_UNCALIBRATED:
-            hidlEvent->u.uncal.x = aidlEvent.payload.get<Event::EventPayload::uncal>().x;
-            hidlEvent->u.uncal.y = aidlEvent.payload.get<Event::EventPayload::uncal>().y;
-            hidlEvent->u.uncal.z = aidlEvent.payload.get<Event::EventPayload::uncal>().z;
-            hidlEvent->u.uncal.x_bias = aidlEvent.payload.get<Event::EventPayload::uncal>().xBias;
-            hidlEvent->u.uncal.y_bias = aidlEvent.payload.get<Event::EventPayload::uncal>().yBias;
-            hidlEvent->u.uncal.z_bias = aidlEvent.payload.get<Event::EventPayload::uncal>().zBias;
-            break;
-        case AidlSensorType::DEVICE_ORIENTATION:
-        case AidlSensorType::LIGHT:
-        case AidlSensorType::PRESSURE:
-        case AidlSensorType::PROXIMITY:
-        case AidlSensorType::RELATIVE_HUMIDITY:
-        case AidlSensorType::AMBIENT_TEMPERATURE:
-        case AidlSensorType::SIGNIFICANT_MOTION:
-        case AidlSensorType::STEP_DETECTOR:
-        case AidlSensorType::TILT_DETECTOR:
-        case AidlSensorType::WAKE_GESTURE:
-        case AidlSensorType::GLANCE_GESTURE:
-        case AidlSensorType::PICK_UP_GESTURE:
-        case AidlSensorType::WRIST_TILT_GESTURE:
-        case AidlSensorType::STATIONARY_DETECT:
-        case AidlSensorType::MOTION_DETECT:
-        case AidlSensorType::HEART_BEAT:
-        case AidlSensorType::LOW_LATENCY_OFFBODY_DETECT:
-        case AidlSensorType::HINGE_ANGLE:
-            hidlEvent->u.scalar = aidlEvent.payload.get<Event::EventPayload::scalar>();
-            break;
-        case AidlSensorType::STEP_COUNTER:
-            hidlEvent->u.stepCount = aidlEvent.payload.get<AidlEvent::EventPayload::stepCount>();
-            break;
-        case AidlSensorType::HEART_RATE:
-            hidlEvent->u.heartRate.bpm =
-                    aidlEvent.payload.get<AidlEvent::EventPayload::heartRate>().bpm;
-            hidlEvent->u.heartRate.status =
-                    (V1_0SensorStatus)aidlEvent.payload.get<Event::EventPayload::heartRate>()
-                            .status;
-            break;
-        case AidlSensorType::POSE_6DOF:
-            std::copy(std::begin(aidlEvent.payload.get<AidlEvent::EventPayload::pose6DOF>().values),
-                      std::end(aidlEvent.payload.get<AidlEvent::EventPayload::pose6DOF>().values),
-                      hidlEvent->u.pose6DOF.data());
-            break;
-        case AidlSensorType::DYNAMIC_SENSOR_META:
-            hidlEvent->u.dynamic.connected =
-                    aidlEvent.payload.get<Event::EventPayload::dynamic>().connected;
-            hidlEvent->u.dynamic.sensorHandle =
-                    aidlEvent.payload.get<Event::EventPayload::dynamic>().sensorHandle;
-            std::copy(
-                    std::begin(
-                            aidlEvent.payload.get<AidlEvent::EventPayload::dynamic>().uuid.values),
-                    std::end(aidlEvent.payload.get<AidlEvent::EventPayload::dynamic>().uuid.values),
-                    hidlEvent->u.dynamic.uuid.data());
-            break;
-        case AidlSensorType::ADDITIONAL_INFO: {
-            const AdditionalInfo& additionalInfo =
-                    aidlEvent.payload.get<AidlEvent::EventPayload::additional>();
-            hidlEvent->u.additional.type = (AdditionalInfoType)additionalInfo.type;
-            hidlEvent->u.additional.serial = additionalInfo.serial;
-
-            switch (additionalInfo.payload.getTag()) {
-                case AdditionalInfo::AdditionalInfoPayload::Tag::dataInt32: {
-                    const auto& aidlData =
-                            additionalInfo.payload
-                                    .get<AdditionalInfo::AdditionalInfoPayload::dataInt32>()
-                                    .values;
-                    std::copy(std::begin(aidlData), std::end(aidlData),
-                              hidlEvent->u.additional.u.data_int32.data());
-                    break;
-                }
-                case AdditionalInfo::AdditionalInfoPayload::Tag::dataFloat: {
-                    const auto& aidlData =
-                            additionalInfo.payload
-                                    .get<AdditionalInfo::AdditionalInfoPayload::dataFloat>()
-                                    .values;
-                    std::copy(std::begin(aidlData), std::end(aidlData),
-                              hidlEvent->u.additional.u.data_float.data());
-                    break;
-                }
-                default:
-                    ALOGE("Invalid sensor additioanl info tag: %d",
-                          static_cast<int32_t>(additionalInfo.payload.getTag()));
-                    break;
-            }
+inline void toAidlHeader(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    aidlEvent->timestamp = hidlEvent.timestamp;
+    aidlEvent->sensorHandle = hidlEvent.sensorHandle;
+    aidlEvent->sensorType = (AidlSensorType)hidlEvent.sensorType;
+}
+
+using ToHidlFn = void (*)(const AidlEvent&, V2_1Event*);
+using ToAidlFn = void (*)(const V2_1Event&, AidlEvent*);
+using ToHidlRunFn = void (*)(const AidlEvent*, size_t, V2_1Event*);
+using ToAidlRunFn = void (*)(const V2_1Event*, size_t, AidlEvent*);
+
+// Converts a run of events of one payload kind, with the payload converter
+// inlined into the loop.
+template <ToHidlFn kConvert>
+void toHidlRun(const AidlEvent* aidlEvents, size_t count, V2_1Event* hidlEvents) {
+    for (size_t i = 0; i < count; ++i) {
+        toHidlHeader(aidlEvents[i], &hidlEvents[i]);
+        kConvert(aidlEvents[i], &hidlEvents[i]);
+    }
+}
+
+template <ToAidlFn kConvert>
+void toAidlRun(const V2_1Event* hidlEvents, size_t count, AidlEvent* aidlEvents) {
+    for (size_t i = 0; i < count; ++i) {
+        toAidlHeader(hidlEvents[i], &aidlEvents[i]);
+        kConvert(hidlEvents[i], &aidlEvents[i]);
+    }
+}
+
+void toHidlInvalid(const AidlEvent& aidlEvent, V2_1Event*) {
+    CHECK_GE((int32_t)aidlEvent.sensorType, (int32_t)SensorType::DEVICE_PRIVATE_BASE);
+}
+
+void toHidlMeta(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    hidlEvent->u.meta.what =
+            (MetaDataEventType)aidlEvent.payload.get<Event::EventPayload::meta>().what;
+}
+
+void toHidlVec3(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    copyPayload<Vec3Layout>(&hidlEvent->u.vec3,
+                            &aidlEvent.payload.get<Event::EventPayload::vec3>());
+}
+
+void toHidlVec4(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    copyPayload<Vec4Layout>(&hidlEvent->u.vec4,
+                            &aidlEvent.payload.get<Event::EventPayload::vec4>());
+}
+
+void toHidlRotation(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    memcpy(hidlEvent->u.data.data(),
+           aidlEvent.payload.get<Event::EventPayload::data>().values.data(),
+           kRotationVectorValues * sizeof(float));
+}
+
+void toHidlUncal(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    copyPayload<UncalLayout>(&hidlEvent->u.uncal,
+                             &aidlEvent.payload.get<Event::EventPayload::uncal>());
+}
+
+void toHidlScalar(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    hidlEvent->u.scalar = aidlEvent.payload.get<Event::EventPayload::scalar>();
+}
+
+void toHidlStepCount(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    hidlEvent->u.stepCount = aidlEvent.payload.get<AidlEvent::EventPayload::stepCount>();
+}
+
+void toHidlHeartRate(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    const auto& heartRate = aidlEvent.payload.get<AidlEvent::EventPayload::heartRate>();
+    hidlEvent->u.heartRate.bpm = heartRate.bpm;
+    hidlEvent->u.heartRate.status = (V1_0SensorStatus)heartRate.status;
+}
+
+void toHidlPose6Dof(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    const auto& pose6Dof = aidlEvent.payload.get<AidlEvent::EventPayload::pose6DOF>();
+    std::copy(std::begin(pose6Dof.values), std::end(pose6Dof.values),
+              hidlEvent->u.pose6DOF.data());
+}
+
+void toHidlDynamic(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    const auto& dynamic = aidlEvent.payload.get<AidlEvent::EventPayload::dynamic>();
+    hidlEvent->u.dynamic.connected = dynamic.connected;
+    hidlEvent->u.dynamic.sensorHandle = dynamic.sensorHandle;
+    std::copy(std::begin(dynamic.uuid.values), std::end(dynamic.uuid.values),
+              hidlEvent->u.dynamic.uuid.data());
+}
+
+void toHidlAdditional(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    const AdditionalInfo& additionalInfo =
+            aidlEvent.payload.get<AidlEvent::EventPayload::additional>();
+    hidlEvent->u.additional.type = (AdditionalInfoType)additionalInfo.type;
+    hidlEvent->u.additional.serial = additionalInfo.serial;
+
+    switch (additionalInfo.payload.getTag()) {
+        case AdditionalInfo::AdditionalInfoPayload::Tag::dataInt32: {
+            const auto& aidlData =
+                    additionalInfo.payload.get<AdditionalInfo::AdditionalInfoPayload::dataInt32>()
+                            .values;
+            std::copy(std::begin(aidlData), std::end(aidlData),
+                      hidlEvent->u.additional.u.data_int32.data());
             break;
         }
-        case AidlSensorType::HEAD_TRACKER: {
-            const auto& ht = aidlEvent.payload.get<Event::EventPayload::headTracker>();
-            hidlEvent->u.data[0] = ht.rx;
-            hidlEvent->u.data[1] = ht.ry;
-            hidlEvent->u.data[2] = ht.rz;
-            hidlEvent->u.data[3] = ht.vx;
-            hidlEvent->u.data[4] = ht.vy;
-            hidlEvent->u.data[5] = ht.vz;
-
-            // IMPORTANT: Because we want to preserve the data range of discontinuityCount,
-            // we assume the data can be interpreted as an int32_t directly (e.g. the underlying
-            // HIDL HAL must be using memcpy or equivalent to store this value).
-            *(reinterpret_cast<int32_t*>(&hidlEvent->u.data[6])) = ht.discontinuityCount;
+        case AdditionalInfo::AdditionalInfoPayload::Tag::dataFloat: {
+            const auto& aidlData =
+                    additionalInfo.payload.get<AdditionalInfo::AdditionalInfoPayload::dataFloat>()
+                            .values;
+            std::copy(std::begin(aidlData), std::end(aidlData),
+                      hidlEvent->u.additional.u.data_float.data());
             break;
         }
-        default: {
-            CHECK_GE((int32_t)aidlEvent.sensorType, (int32_t)SensorType::DEVICE_PRIVATE_BASE);
-            std::copy(std::begin(aidlEvent.payload.get<AidlEvent::EventPayload::data>().values),
-                      std::end(aidlEvent.payload.get<AidlEvent::EventPayload::data>().values),
-                      hidlEvent->u.data.data());
+        default:
+            ALOGE("Invalid sensor additioanl info tag: %d",
+                  static_cast<int32_t>(additionalInfo.payload.getTag()));
             break;
-        }
     }
 }
 
+void toHidlHeadTracker(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    const auto& ht = aidlEvent.payload.get<Event::EventPayload::headTracker>();
+    hidlEvent->u.data[0] = ht.rx;
+    hidlEvent->u.data[1] = ht.ry;
+    hidlEvent->u.data[2] = ht.rz;
+    hidlEvent->u.data[3] = ht.vx;
+    hidlEvent->u.data[4] = ht.vy;
+    hidlEvent->u.data[5] = ht.vz;
+
+    // IMPORTANT: Because we want to preserve the data range of discontinuityCount,
+    // we assume the data can be interpreted as an int32_t directly (e.g. the underlying
+    // HIDL HAL must be using memcpy or equivalent to store this value).
+    *(reinterpret_cast<int32_t*>(&hidlEvent->u.data[6])) = ht.discontinuityCount;
+}
+
+void toHidlData(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    const auto& values = aidlEvent.payload.get<AidlEvent::EventPayload::data>().values;
+    memcpy(hidlEvent->u.data.data(), values.data(), sizeof(values));
+}
+
+// Run converters for each PayloadKind, indexed by its value.
+constexpr std::array<ToHidlRunFn, static_cast<size_t>(PayloadKind::COUNT)> kToHidlRun = {
+        toHidlRun<toHidlInvalid>,
+        toHidlRun<toHidlMeta>,
+        toHidlRun<toHidlVec3>,
+        toHidlRun<toHidlVec4>,
+        toHidlRun<toHidlRotation>,
+        toHidlRun<toHidlUncal>,
+        toHidlRun<toHidlScalar>,
+        toHidlRun<toHidlStepCount>,
+        toHidlRun<toHidlHeartRate>,
+        toHidlRun<toHidlPose6Dof>,
+        toHidlRun<toHidlDynamic>,
+        toHidlRun<toHidlAdditional>,
+        toHidlRun<toHidlHeadTracker>,
+        toHidlRun<toHidlData>,
+};
+
+void toAidlInvalid(const V2_1Event& hidlEvent, AidlEvent*) {
+    CHECK_GE((int32_t)hidlEvent.sensorType, (int32_t)V2_1SensorType::DEVICE_PRIVATE_BASE);
+}
+
+void toAidlMeta(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    AidlEvent::EventPayload::MetaData meta;
+    meta.what = (Event::EventPayload::MetaData::MetaDataEventType)hidlEvent.u.meta.what;
+    aidlEvent->payload.set<Event::EventPayload::meta>(meta);
+}
+
+void toAidlVec3(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    AidlEvent::EventPayload::Vec3 vec3;
+    copyPayload<Vec3Layout>(&vec3, &hidlEvent.u.vec3);
+    aidlEvent->payload.set<Event::EventPayload::vec3>(vec3);
+}
+
+void toAidlVec4(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    AidlEvent::EventPayload::Vec4 vec4;
+    copyPayload<Vec4Layout>(&vec4, &hidlEvent.u.vec4);
+    aidlEvent->payload.set<Event::EventPayload::vec4>(vec4);
+}
+
+void toAidlRotation(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    AidlEvent::EventPayload::Data data;
+    memcpy(data.values.data(), hidlEvent.u.data.data(), kRotationVectorValues * sizeof(float));
+    aidlEvent->payload.set<Event::EventPayload::data>(data);
+}
+
+void toAidlUncal(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    AidlEvent::EventPayload::Uncal uncal;
+    copyPayload<UncalLayout>(&uncal, &hidlEvent.u.uncal);
+    aidlEvent->payload.set<Event::EventPayload::uncal>(uncal);
+}
+
+void toAidlScalar(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    aidlEvent->payload.set<Event::EventPayload::scalar>(hidlEvent.u.scalar);
+}
+
+void toAidlStepCount(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    aidlEvent->payload.set<Event::EventPayload::stepCount>(hidlEvent.u.stepCount);
+}
+
+void toAidlHeartRate(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    AidlEvent::EventPayload::HeartRate heartRate;
+    heartRate.bpm = hidlEvent.u.heartRate.bpm;
+    heartRate.status = (SensorStatus)hidlEvent.u.heartRate.status;
+    aidlEvent->payload.set<Event::EventPayload::heartRate>(heartRate);
+}
+
+void toAidlPose6Dof(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    AidlEvent::EventPayload::Pose6Dof pose6Dof;
+    std::copy(hidlEvent.u.pose6DOF.data(),
+              hidlEvent.u.pose6DOF.data() + hidlEvent.u.pose6DOF.size(),
+              std::begin(pose6Dof.values));
+    aidlEvent->payload.set<Event::EventPayload::pose6DOF>(pose6Dof);
+}
+
+void toAidlDynamic(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    DynamicSensorInfo dynamicSensorInfo;
+    dynamicSensorInfo.connected = hidlEvent.u.dynamic.connected;
+    dynamicSensorInfo.sensorHandle = hidlEvent.u.dynamic.sensorHandle;
+    std::copy(hidlEvent.u.dynamic.uuid.data(),
+              hidlEvent.u.dynamic.uuid.data() + hidlEvent.u.dynamic.uuid.size(),
+              std::begin(dynamicSensorInfo.uuid.values));
+    aidlEvent->payload.set<Event::EventPayload::dynamic>(dynamicSensorInfo);
+}
+
+void toAidlAdditional(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    AdditionalInfo additionalInfo;
+    additionalInfo.type = (AdditionalInfo::AdditionalInfoType)hidlEvent.u.additional.type;
+    additionalInfo.serial = hidlEvent.u.additional.serial;
+
+    AdditionalInfo::AdditionalInfoPayload::Int32Values int32Values;
+    std::copy(hidlEvent.u.additional.u.data_int32.data(),
+              hidlEvent.u.additional.u.data_int32.data() +
+                      hidlEvent.u.additional.u.data_int32.size(),
+              std::begin(int32Values.values));
+    additionalInfo.payload.set<AdditionalInfo::AdditionalInfoPayload::dataInt32>(int32Values);
+    aidlEvent->payload.set<Event::EventPayload::additional>(additionalInfo);
+}
+
+void toAidlHeadTracker(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    Event::EventPayload::HeadTracker headTracker;
+    headTracker.rx = hidlEvent.u.data[0];
+    headTracker.ry = hidlEvent.u.data[1];
+    headTracker.rz = hidlEvent.u.data[2];
+    headTracker.vx = hidlEvent.u.data[3];
+    headTracker.vy = hidlEvent.u.data[4];
+    headTracker.vz = hidlEvent.u.data[5];
+
+    // IMPORTANT: Because we want to preserve the data range of discontinuityCount,
+    // we assume the data can be interpreted as an int32_t directly (e.g. the underlying
+    // HIDL HAL must be using memcpy or equivalent to store this value).
+    headTracker.discontinuityCount = *(reinterpret_cast<const int32_t*>(&hidlEvent.u.data[6]));
+
+    aidlEvent->payload.set<Event::EventPayload::Tag::headTracker>(headTracker);
+}
+
+void toAidlData(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
+    AidlEvent::EventPayload::Data data;
+    memcpy(data.values.data(), hidlEvent.u.data.data(), sizeof(data.values));
+    aidlEvent->payload.set<Event::EventPayload::data>(data);
+}
+
+// Run converters for each PayloadKind, indexed by its value.
+constexpr std::array<ToAidlRunFn, static_cast<size_t>(PayloadKind::COUNT)> kToAidlRun = {
+        toAidlRun<toAidlInvalid>,
+        toAidlRun<toAidlMeta>,
+        toAidlRun<toAidlVec3>,
+        toAidlRun<toAidlVec4>,
+        toAidlRun<toAidlRotation>,
+        toAidlRun<toAidlUncal>,
+        toAidlRun<toAidlScalar>,
+        toAidlRun<toAidlStepCount>,
+        toAidlRun<toAidlHeartRate>,
+        toAidlRun<toAidlPose6Dof>,
+        toAidlRun<toAidlDynamic>,
+        toAidlRun<toAidlAdditional>,
+        toAidlRun<toAidlHeadTracker>,
+        toAidlRun<toAidlData>,
+};
+
+}  // namespace
+
+void convertToHidlEvent(const AidlEvent& aidlEvent, V2_1Event* hidlEvent) {
+    static_assert(decltype(hidlEvent->u.data)::elementCount() == 16);
+    const PayloadKind kind = payloadKind(static_cast<int32_t>(aidlEvent.sensorType));
+    kToHidlRun[static_cast<size_t>(kind)](&aidlEvent, 1, hidlEvent);
+}
+
 void convertToAidlEvent(const V2_1Event& hidlEvent, AidlEvent* aidlEvent) {
     static_assert(decltype(hidlEvent.u.data)::elementCount() == 16);
-    aidlEvent->timestamp = hidlEvent.timestamp;
-    aidlEvent->sensorHandle = hidlEvent.sensorHandle;
-    aidlEvent->sensorType = (AidlSensorType)hidlEvent.sensorType;
-    switch (hidlEvent.sensorType) {
-        case V2_1SensorType::META_DATA: {
-            AidlEvent::EventPayload::MetaData meta;
-            meta.what = (Event::EventPayload::MetaData::MetaDataEventType)hidlEvent.u.meta.what;
-            aidlEvent->payload.set<Event::EventPayload::meta>(meta);
-            break;
-        }
-        case V2_1SensorType::ACCELEROMETER:
-        case V2_1SensorType::MAGNETIC_FIELD:
-        case V2_1SensorType::ORIENTATION:
-        case V2_1SensorType::GYROSCOPE:
-        case V2_1SensorType::GRAVITY:
-        case V2_1SensorType::LINEAR_ACCELERATION: {
-            AidlEvent::EventPayload::Vec3 vec3;
-            vec3.x = hidlEvent.u.vec3.x;
-            vec3.y = hidlEvent.u.vec3.y;
-            vec3.z = hidlEvent.u.vec3.z;
-            vec3.status = (SensorStatus)hidlEvent.u.vec3.status;
-            aidlEvent->payload.set<Event::EventPayload::vec3>(vec3);
-            break;
-        }
-        case V2_1SensorType::GAME_ROTATION_VECTOR: {
-            AidlEvent::EventPayload::Vec4 vec4;
-            vec4.x = hidlEvent.u.vec4.x;
-            vec4.y = hidlEvent.u.vec4.y;
-            vec4.z = hidlEvent.u.vec4.z;
-            vec4.w = hidlEvent.u.vec4.w;
-            aidlEvent->payload.set<Event::EventPayload::vec4>(vec4);
-            break;
-        }
-        case V2_1SensorType::ROTATION_VECTOR:
-        case V2_1SensorType::GEOMAGNETIC_ROTATION_VECTOR: {
-            AidlEvent::EventPayload::Data data;
-            std::copy(hidlEvent.u.data.data(), hidlEvent.u.data.data() + 5,
-                      std::begin(data.values));
-            aidlEvent->payload.set<Event::EventPayload::data>(data);
-            break;
-        }
-        case V2_1SensorType::MAGNETIC_FIELD_UNCALIBRATED:
-        case V2_1SensorType::GYROSCOPE_UNCALIBRATED:
-        case V2_1SensorType::ACCELEROMETER_UNCALIBRATED: {
-            AidlEvent::EventPayload::Uncal uncal;
-            uncal.x = hidlEvent.u.uncal.x;
-            uncal.y = hidlEvent.u.uncal.y;
-            uncal.z = hidlEvent.u.uncal.z;
-            uncal.xBias = hidlEvent.u.uncal.x_bias;
-            uncal.yBias = hidlEvent.u.uncal.y_bias;
-            uncal.zBias = hidlEvent.u.uncal.z_bias;
-            aidlEvent->payload.set<Event::EventPayload::uncal>(uncal);
-            break;
-        }
-        case V2_1SensorType::DEVICE_ORIENTATION:
-        case V2_1SensorType::LIGHT:
-        case V2_1SensorType::PRESSURE:
-        case V2_1SensorType::PROXIMITY:
-        case V2_1SensorType::RELATIVE_HUMIDITY:
-        case V2_1SensorType::AMBIENT_TEMPERATURE:
-        case V2_1SensorType::SIGNIFICANT_MOTION:
-        case V2_1SensorType::STEP_DETECTOR:
-        case V2_1SensorType::TILT_DETECTOR:
-        case V2_1SensorType::WAKE_GESTURE:
-        case V2_1SensorType::GLANCE_GESTURE:
-        case V2_1SensorType::PICK_UP_GESTURE:
-        case V2_1SensorType::WRIST_TILT_GESTURE:
-        case V2_1SensorType::STATIONARY_DETECT:
-        case V2_1SensorType::MOTION_DETECT:
-        case V2_1SensorType::HEART_BEAT:
-        case V2_1SensorType::LOW_LATENCY_OFFBODY_DETECT:
-        case V2_1SensorType::HINGE_ANGLE:
-            aidlEvent->payload.set<Event::EventPayload::scalar>(hidlEvent.u.scalar);
-            break;
-        case V2_1SensorType::STEP_COUNTER:
-            aidlEvent->payload.set<Event::EventPayload::stepCount>(hidlEvent.u.stepCount);
-            break;
-        case V2_1SensorType::HEART_RATE: {
-            AidlEvent::EventPayload::HeartRate heartRate;
-            heartRate.bpm = hidlEvent.u.heartRate.bpm;
-            heartRate.status = (SensorStatus)hidlEvent.u.heartRate.status;
-            aidlEvent->payload.set<Event::EventPayload::heartRate>(heartRate);
-            break;
-        }
-        case V2_1SensorType::POSE_6DOF: {
-            AidlEvent::EventPayload::Pose6Dof pose6Dof;
-            std::copy(hidlEvent.u.pose6DOF.data(),
-                      hidlEvent.u.pose6DOF.data() + hidlEvent.u.pose6DOF.size(),
-                      std::begin(pose6Dof.values));
-            aidlEvent->payload.set<Event::EventPayload::pose6DOF>(pose6Dof);
-            break;
-        }
-        case V2_1SensorType::DYNAMIC_SENSOR_META: {
-            DynamicSensorInfo dynamicSensorInfo;
-            dynamicSensorInfo.connected = hidlEvent.u.dynamic.connected;
-            dynamicSensorInfo.sensorHandle = hidlEvent.u.dynamic.sensorHandle;
-            std::copy(hidlEvent.u.dynamic.uuid.data(),
-                      hidlEvent.u.dynamic.uuid.data() + hidlEvent.u.dynamic.uuid.size(),
-                      std::begin(dynamicSensorInfo.uuid.values));
-            aidlEvent->payload.set<Event::EventPayload::dynamic>(dynamicSensorInfo);
-            break;
-        }
-        case V2_1SensorType::ADDITIONAL_INFO: {
-            AdditionalInfo additionalInfo;
-            additionalInfo.type = (AdditionalInfo::AdditionalInfoType)hidlEvent.u.additional.type;
-            additionalInfo.serial = hidlEvent.u.additional.serial;
-
-            AdditionalInfo::AdditionalInfoPayload::Int32Values int32Values;
-            std::copy(hidlEvent.u.additional.u.data_int32.data(),
-                      hidlEvent.u.additional.u.data_int32.data() +
-                              hidlEvent.u.additional.u.data_int32.size(),
-                      std::begin(int32Values.values));
-            additionalInfo.payload.set<AdditionalInfo::AdditionalInfoPayload::dataInt32>(
-                    int32Values);
-            aidlEvent->payload.set<Event::EventPayload::additional>(additionalInfo);
-            break;
+    const PayloadKind kind = payloadKind(static_cast<int32_t>(hidlEvent.sensorType));
+    kToAidlRun[static_cast<size_t>(kind)](&hidlEvent, 1, aidlEvent);
+}
+
+void convertToHidlEvents(const AidlEvent* aidlEvents, size_t count, V2_1Event* hidlEvents) {
+    size_t start = 0;
+    while (start < count) {
+        const AidlSensorType type = aidlEvents[start].sensorType;
+        size_t end = start + 1;
+        while (end < count && aidlEvents[end].sensorType == type) {
+            ++end;
         }
-        default: {
-            if (static_cast<int32_t>(hidlEvent.sensorType) ==
-                static_cast<int32_t>(AidlSensorType::HEAD_TRACKER)) {
-                Event::EventPayload::HeadTracker headTracker;
-                headTracker.rx = hidlEvent.u.data[0];
-                headTracker.ry = hidlEvent.u.data[1];
-                headTracker.rz = hidlEvent.u.data[2];
-                headTracker.vx = hidlEvent.u.data[3];
-                headTracker.vy = hidlEvent.u.data[4];
-                headTracker.vz = hidlEvent.u.data[5];
-
-                // IMPORTANT: Because we want to preserve the data range of discontinuityCount,
-                // we assume the data can be interpreted as an int32_t directly (e.g. the underlying
-                // HIDL HAL must be using memcpy or equivalent to store this value).
-                headTracker.discontinuityCount =
-                        *(reinterpret_cast<const int32_t*>(&hidlEvent.u.data[6]));
-
-                aidlEvent->payload.set<Event::EventPayload::Tag::headTracker>(headTracker);
-            } else {
-                CHECK_GE((int32_t)hidlEvent.sensorType,
-                         (int32_t)V2_1SensorType::DEVICE_PRIVATE_BASE);
-                AidlEvent::EventPayload::Data data;
-                std::copy(hidlEvent.u.data.data(),
-                          hidlEvent.u.data.data() + hidlEvent.u.data.size(),
-                          std::begin(data.values));
-                aidlEvent->payload.set<Event::EventPayload::data>(data);
-            }
-            break;
+        kToHidlRun[static_cast<size_t>(payloadKind((int32_t)type))](
+                aidlEvents + start, end - start, hidlEvents + start);
+        start = end;
+    }
+}
+
+void convertToAidlEvents(const V2_1Event* hidlEvents, size_t count, AidlEvent* aidlEvents) {
+    size_t start = 0;
+    while (start < count) {
+        const V2_1SensorType type = hidlEvents[start].sensorType;
+        size_t end = start + 1;
+        while (end < count && hidlEvents[end].sensorType == type) {
+            ++end;
         }
+        kToAidlRun[static_cast<size_t>(payloadKind((int32_t)type))](
+                hidlEvents + start, end - start, aidlEvents + start);
+        start = end;
     }
 }
 
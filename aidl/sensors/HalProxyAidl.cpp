@@ -119,6 +119,51 @@ static ::android::hardware::sensors::V1_0::SharedMemInfo convertSharedMemInfo(
     return v1SharedMemInfo;
 }
 
+// Rewrites applied to sub-HAL sensors before they are reported.
+struct PermissionFixup {
+  const char *from;
+  const char *to;
+};
+
+static constexpr PermissionFixup kPermissionFixups[] = {
+    {"com.samsung.permission.SSENSOR", ""},
+};
+
+struct TypeFixup {
+  const char *typeAsString;
+  ::android::hardware::sensors::V2_1::SensorType type;
+  const char *newTypeAsString;
+  float maxRange;
+};
+
+static constexpr TypeFixup kTypeFixups[] = {
+    {"com.samsung.sensor.physical_proximity",
+     ::android::hardware::sensors::V2_1::SensorType::PROXIMITY,
+     SENSOR_STRING_TYPE_PROXIMITY, 1},
+    {"com.samsung.sensor.hover_proximity",
+     ::android::hardware::sensors::V2_1::SensorType::PROXIMITY,
+     SENSOR_STRING_TYPE_PROXIMITY, 1},
+};
+
+static void
+applySensorFixups(::android::hardware::sensors::V2_1::SensorInfo *sensor) {
+  for (const auto &fixup : kPermissionFixups) {
+    if (sensor->requiredPermission == fixup.from) {
+      sensor->requiredPermission = fixup.to;
+      break;
+    }
+  }
+  for (const auto &fixup : kTypeFixups) {
+    if (sensor->typeAsString == fixup.typeAsString) {
+      ALOGI("Fixing %s", sensor->typeAsString.c_str());
+      sensor->type = fixup.type;
+      sensor->typeAsString = fixup.newTypeAsString;
+      sensor->maxRange = fixup.maxRange;
+      break;
+    }
+  }
+}
+
 ScopedAStatus HalProxyAidl::activate(int32_t in_sensorHandle, bool in_enabled) {
   return resultToAStatus(HalProxy::activate(in_sensorHandle, in_enabled));
 }
@@ -154,20 +199,21 @@ ScopedAStatus HalProxyAidl::flush(int32_t in_sensorHandle) {
 
 ScopedAStatus HalProxyAidl::getSensorsList(
     std::vector<::aidl::android::hardware::sensors::SensorInfo> *_aidl_return) {
-  for (const auto &sensor : HalProxy::getSensors()) {
-    SensorInfo dst = sensor.second;
-
-    if (dst.requiredPermission == "com.samsung.permission.SSENSOR") {
-        dst.requiredPermission = "";
-    }
+  std::lock_guard<std::mutex> lock(mSensorListLock);
+  if (!mSensorListValid) {
+    buildSensorListLocked();
+  }
+  *_aidl_return = mSensorList;
+  return ScopedAStatus::ok();
+}
 
-    if (dst.typeAsString == "com.samsung.sensor.physical_proximity" ||
-            dst.typeAsString == "com.samsung.sensor.hover_proximity") {
-        ALOGI("Fixing %s", dst.typeAsString.c_str());
-        dst.type = ::android::hardware::sensors::V2_1::SensorType::PROXIMITY;
-        dst.typeAsString = SENSOR_STRING_TYPE_PROXIMITY;
-        dst.maxRange = 1;
-    }
+void HalProxyAidl::buildSensorListLocked() {
+  const auto sensors = HalProxy::getSensors();
+  mSensorList.clear();
+  mSensorList.reserve(sensors.size());
+  for (const auto &sensor : sensors) {
+    ::android::hardware::sensors::V2_1::SensorInfo dst = sensor.second;
+    applySensorFixups(&dst);
 
 #ifdef VERBOSE
     ALOGI( "SENSOR NAME:%s           ", dst.name.c_str());
@@ -176,9 +222,14 @@ ScopedAStatus HalProxyAidl::getSensorsList(
     ALOGI( "       TYPE_AS_STRING:%s ", dst.typeAsString.c_str());
 #endif
 
-    _aidl_return->push_back(convertSensorInfo(dst));
+    mSensorList.push_back(convertSensorInfo(dst));
   }
-  return ScopedAStatus::ok();
+  mSensorListValid = true;
+}
+
+void HalProxyAidl::invalidateSensorList() {
+  std::lock_guard<std::mutex> lock(mSensorListLock);
+  mSensorListValid = false;
 }
 
 ScopedAStatus HalProxyAidl::initialize(
@@ -188,15 +239,16 @@ ScopedAStatus HalProxyAidl::initialize(
     const std::shared_ptr<ISensorsCallback> &in_sensorsCallback) {
   ::android::sp<::android::hardware::sensors::V2_1::implementation::
                     ISensorsCallbackWrapperBase>
-      dynamicCallback = new ISensorsCallbackWrapperAidl(in_sensorsCallback);
+      dynamicCallback = new ISensorsCallbackWrapperAidl(
+          in_sensorsCallback, [this] { invalidateSensorList(); });
 
   auto aidlEventQueue = std::make_unique<::android::AidlMessageQueue<
       ::aidl::android::hardware::sensors::Event, SynchronizedReadWrite>>(
       in_eventQueueDescriptor, true /* resetPointers */);
   std::unique_ptr<::android::hardware::sensors::V2_1::implementation::
                       EventMessageQueueWrapperBase>
-      eventQueue =
-          std::make_unique<EventMessageQueueWrapperAidl>(aidlEventQueue);
+      eventQueue = std::make_unique<EventMessageQueueWrapperAidl>(
+          aidlEventQueue, mEventStats);
 
   auto aidlWakeLockQueue = std::make_unique<
       ::android::AidlMessageQueue<int32_t, SynchronizedReadWrite>>(
@@ -257,6 +309,7 @@ binder_status_t HalProxyAidl::dump(int fd, const char ** /* args */,
   nativeHandle->data[0] = fd;
 
   HalProxy::debug(nativeHandle, {} /* args */);
+  mEventStats->dump(fd);
 
   native_handle_delete(nativeHandle);
   return STATUS_OK;
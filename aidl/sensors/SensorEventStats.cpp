@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SensorEventStats.h"
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <utils/SystemClock.h>
+
+#include <cinttypes>
+
+using V2_1Event = ::android::hardware::sensors::V2_1::Event;
+using V2_1SensorType = ::android::hardware::sensors::V2_1::SensorType;
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace implementation {
+
+SensorEventStats::SensorEventStats() : mWrites(0), mUntrackedEvents(0), mLastDumpNs(0) {
+    for (auto& slot : mSlots) {
+        slot.handle.store(kEmptyHandle, std::memory_order_relaxed);
+        slot.events.store(0, std::memory_order_relaxed);
+        slot.batches.store(0, std::memory_order_relaxed);
+        slot.maxBatch.store(0, std::memory_order_relaxed);
+        slot.dropped.store(0, std::memory_order_relaxed);
+        slot.blocked.store(0, std::memory_order_relaxed);
+        for (auto& bucket : slot.latency) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        slot.dumpedEvents.store(0, std::memory_order_relaxed);
+        slot.lastWrite = 0;
+        slot.writeEvents = 0;
+    }
+}
+
+SensorEventStats::Slot* SensorEventStats::findSlot(int32_t handle) {
+    // Open addressing; slots are claimed once and never freed.
+    const size_t start = (static_cast<uint32_t>(handle) * 2654435761u) % kMaxSensors;
+    for (size_t i = 0; i < kMaxSensors; ++i) {
+        Slot& slot = mSlots[(start + i) % kMaxSensors];
+        int32_t current = slot.handle.load(std::memory_order_acquire);
+        if (current == handle) {
+            return &slot;
+        }
+        if (current == kEmptyHandle &&
+            (slot.handle.compare_exchange_strong(current, handle, std::memory_order_acq_rel) ||
+             current == handle)) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+size_t SensorEventStats::latencyBucket(int64_t latencyNs) {
+    const uint64_t us = latencyNs > 0 ? static_cast<uint64_t>(latencyNs) / 1000 : 0;
+    if (us == 0) {
+        return 0;
+    }
+    const size_t bucket = 64 - __builtin_clzll(us);
+    return bucket < kLatencyBuckets ? bucket : kLatencyBuckets - 1;
+}
+
+std::string SensorEventStats::latencyLabel(size_t bucket) {
+    if (bucket >= kLatencyBuckets) {
+        return "-";
+    }
+    // The last bucket has no upper bound.
+    if (bucket == kLatencyBuckets - 1) {
+        return ::android::base::StringPrintf(">=%" PRIu64 "us", 1ull << (bucket - 1));
+    }
+    return ::android::base::StringPrintf("<%" PRIu64 "us", 1ull << bucket);
+}
+
+void SensorEventStats::recordWrite(const V2_1Event* events, size_t count, bool written,
+                                   bool blocked) {
+    const int64_t now = written ? ::android::elapsedRealtimeNano() : 0;
+    const uint64_t write = ++mWrites;
+    size_t start = 0;
+    while (start < count) {
+        const int32_t handle = events[start].sensorHandle;
+        size_t end = start + 1;
+        while (end < count && events[end].sensorHandle == handle) {
+            ++end;
+        }
+        const uint64_t run = end - start;
+        Slot* slot = findSlot(handle);
+        if (slot == nullptr) {
+            mUntrackedEvents.fetch_add(run, std::memory_order_relaxed);
+            start = end;
+            continue;
+        }
+        // Runs of the same sensor later in this write extend its batch.
+        const bool newBatch = slot->lastWrite != write;
+        slot->lastWrite = write;
+        if (!written) {
+            if (blocked) {
+                slot->dropped.fetch_add(run, std::memory_order_relaxed);
+            }
+            start = end;
+            continue;
+        }
+        if (newBatch) {
+            slot->writeEvents = 0;
+            slot->batches.fetch_add(1, std::memory_order_relaxed);
+            if (blocked) {
+                slot->blocked.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        slot->writeEvents += run;
+        slot->events.fetch_add(run, std::memory_order_relaxed);
+        if (slot->writeEvents > slot->maxBatch.load(std::memory_order_relaxed)) {
+            slot->maxBatch.store(slot->writeEvents, std::memory_order_relaxed);
+        }
+        for (size_t i = start; i < end; ++i) {
+            // Flush complete events carry no sample time.
+            if (events[i].sensorType == V2_1SensorType::META_DATA || events[i].timestamp <= 0) {
+                continue;
+            }
+            slot->latency[latencyBucket(now - events[i].timestamp)].fetch_add(
+                    1, std::memory_order_relaxed);
+        }
+        start = end;
+    }
+}
+
+void SensorEventStats::dump(int fd) {
+    const int64_t now = ::android::elapsedRealtimeNano();
+    const int64_t last = mLastDumpNs.exchange(now, std::memory_order_relaxed);
+    const double seconds = last > 0 ? (now - last) / 1e9 : 0;
+
+    std::string buf = ::android::base::StringPrintf(
+            "Event FMQ writes per sensor (rates over the last %.1fs, latency is sample time to "
+            "enqueue):\n",
+            seconds);
+    for (auto& slot : mSlots) {
+        const int32_t handle = slot.handle.load(std::memory_order_acquire);
+        if (handle == kEmptyHandle) {
+            continue;
+        }
+        const uint64_t events = slot.events.load(std::memory_order_relaxed);
+        const uint64_t batches = slot.batches.load(std::memory_order_relaxed);
+        const uint64_t delta =
+                events - slot.dumpedEvents.exchange(events, std::memory_order_relaxed);
+
+        std::array<uint64_t, kLatencyBuckets> latency;
+        uint64_t samples = 0;
+        for (size_t i = 0; i < kLatencyBuckets; ++i) {
+            latency[i] = slot.latency[i].load(std::memory_order_relaxed);
+            samples += latency[i];
+        }
+        // Buckets holding the 50th and 99th percentile.
+        size_t p50 = kLatencyBuckets;
+        size_t p99 = kLatencyBuckets;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kLatencyBuckets && samples > 0; ++i) {
+            seen += latency[i];
+            if (p50 == kLatencyBuckets && seen * 2 >= samples) {
+                p50 = i;
+            }
+            if (seen * 100 >= samples * 99) {
+                p99 = i;
+                break;
+            }
+        }
+
+        ::android::base::StringAppendF(
+                &buf,
+                "  0x%08x: %.1f events/s, %" PRIu64 " events in %" PRIu64
+                " batches (avg %.1f, max %" PRIu64 "), %" PRIu64 " dropped, %" PRIu64
+                " blocked, latency p50 %s p99 %s\n",
+                handle, seconds > 0 ? delta / seconds : 0.0, events, batches,
+                batches > 0 ? static_cast<double>(events) / batches : 0.0,
+                slot.maxBatch.load(std::memory_order_relaxed),
+                slot.dropped.load(std::memory_order_relaxed),
+                slot.blocked.load(std::memory_order_relaxed), latencyLabel(p50).c_str(),
+                latencyLabel(p99).c_str());
+    }
+    const uint64_t untracked = mUntrackedEvents.load(std::memory_order_relaxed);
+    if (untracked > 0) {
+        ::android::base::StringAppendF(&buf, "  %" PRIu64 " events from untracked sensors\n",
+                                       untracked);
+    }
+    ::android::base::WriteStringToFd(buf, fd);
+}
+
+}  // namespace implementation
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -43,6 +43,19 @@ void convertToHidlEvent(const ::aidl::android::hardware::sensors::Event& aidlEve
 void convertToAidlEvent(const ::android::hardware::sensors::V2_1::Event& hidlEvent,
                         ::aidl::android::hardware::sensors::Event* aidlEvent);
 
+/**
+ * Converts |count| AIDL events into HIDL V2.1 events. The conversion is looked up once per run of
+ * events with the same sensor type, so batches from one sensor convert without per-event dispatch.
+ */
+void convertToHidlEvents(const ::aidl::android::hardware::sensors::Event* aidlEvents, size_t count,
+                         ::android::hardware::sensors::V2_1::Event* hidlEvents);
+
+/**
+ * Converts |count| HIDL V2.1 events into AIDL events, see convertToHidlEvents().
+ */
+void convertToAidlEvents(const ::android::hardware::sensors::V2_1::Event* hidlEvents, size_t count,
+                         ::aidl::android::hardware::sensors::Event* aidlEvents);
+
 }  // namespace implementation
 }  // namespace sensors
 }  // namespace hardware
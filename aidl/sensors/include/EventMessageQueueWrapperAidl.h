@@ -21,6 +21,7 @@
 #include "ConvertUtils.h"
 #include "EventMessageQueueWrapper.h"
 #include "ISensorsWrapper.h"
+#include "SensorEventStats.h"
 
 namespace aidl {
 namespace android {
@@ -34,8 +35,9 @@ class EventMessageQueueWrapperAidl
     EventMessageQueueWrapperAidl(
             std::unique_ptr<::android::AidlMessageQueue<
                     ::aidl::android::hardware::sensors::Event,
-                    ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>>& queue)
-        : mQueue(std::move(queue)) {}
+                    ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>>& queue,
+            std::shared_ptr<SensorEventStats> stats)
+        : mQueue(std::move(queue)), mStats(std::move(stats)) {}
 
     virtual std::atomic<uint32_t>* getEventFlagWord() override {
         return mQueue->getEventFlagWord();
@@ -48,45 +50,67 @@ class EventMessageQueueWrapperAidl
     virtual bool read(::android::hardware::sensors::V2_1::Event* events,
                       size_t numToRead) override {
         bool success = mQueue->read(mIntermediateEventBuffer.data(), numToRead);
-        for (int i = 0; i < numToRead; ++i) {
-            convertToHidlEvent(mIntermediateEventBuffer[i], &events[i]);
-        }
+        convertToHidlEvents(mIntermediateEventBuffer.data(), numToRead, events);
         return success;
     }
 
     bool write(const ::android::hardware::sensors::V2_1::Event* events,
                size_t numToWrite) override {
-        for (int i = 0; i < numToWrite; ++i) {
-            convertToAidlEvent(events[i], &mIntermediateEventBuffer[i]);
-        }
-        return mQueue->write(mIntermediateEventBuffer.data(), numToWrite);
+        bool success = writeInPlace(events, numToWrite);
+        mStats->recordWrite(events, numToWrite, success, false /* blocked */);
+        return success;
     }
 
     virtual bool write(
             const std::vector<::android::hardware::sensors::V2_1::Event>& events) override {
-        for (int i = 0; i < events.size(); ++i) {
-            convertToAidlEvent(events[i], &mIntermediateEventBuffer[i]);
-        }
-        return mQueue->write(mIntermediateEventBuffer.data(), events.size());
+        return write(events.data(), events.size());
     }
 
     bool writeBlocking(const ::android::hardware::sensors::V2_1::Event* events, size_t count,
                        uint32_t readNotification, uint32_t writeNotification, int64_t timeOutNanos,
                        ::android::hardware::EventFlag* evFlag) override {
-        for (int i = 0; i < count; ++i) {
-            convertToAidlEvent(events[i], &mIntermediateEventBuffer[i]);
+        // Only a full queue has to wait for the reader, which goes through the
+        // intermediate buffer so that the FMQ can block on the event flag.
+        if (evFlag != nullptr && writeInPlace(events, count)) {
+            if (writeNotification != 0) {
+                evFlag->wake(writeNotification);
+            }
+            mStats->recordWrite(events, count, true, false /* blocked */);
+            return true;
         }
-        return mQueue->writeBlocking(mIntermediateEventBuffer.data(), count, readNotification,
-                                     writeNotification, timeOutNanos, evFlag);
+        convertToAidlEvents(events, count, mIntermediateEventBuffer.data());
+        bool success = mQueue->writeBlocking(mIntermediateEventBuffer.data(), count,
+                                             readNotification, writeNotification, timeOutNanos,
+                                             evFlag);
+        mStats->recordWrite(events, count, success, true /* blocked */);
+        return success;
     }
 
     size_t getQuantumCount() override { return mQueue->getQuantumCount(); }
 
   private:
-    std::unique_ptr<::android::AidlMessageQueue<
+    using AidlEventQueue = ::android::AidlMessageQueue<
             ::aidl::android::hardware::sensors::Event,
-            ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>>
-            mQueue;
+            ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>;
+
+    // Converts |events| directly into reserved queue slots; Event is
+    // @FixedSize, so the reader copies them out as raw bytes. Like write(), it
+    // writes nothing and returns false if they do not all fit.
+    bool writeInPlace(const ::android::hardware::sensors::V2_1::Event* events, size_t count) {
+        AidlEventQueue::MemTransaction tx;
+        if (!mQueue->beginWrite(count, &tx)) {
+            return false;
+        }
+        // The reservation wraps around the end of the ring at most once.
+        const auto& first = tx.getFirstRegion();
+        const auto& second = tx.getSecondRegion();
+        convertToAidlEvents(events, first.getLength(), first.getAddress());
+        convertToAidlEvents(events + first.getLength(), second.getLength(), second.getAddress());
+        return mQueue->commitWrite(count);
+    }
+
+    std::unique_ptr<AidlEventQueue> mQueue;
+    std::shared_ptr<SensorEventStats> mStats;
     std::array<::aidl::android::hardware::sensors::Event,
                ::android::hardware::sensors::V2_1::implementation::MAX_RECEIVE_BUFFER_EVENT_COUNT>
             mIntermediateEventBuffer;
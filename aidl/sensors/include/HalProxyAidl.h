@@ -17,7 +17,11 @@
 #pragma once
 
 #include <aidl/android/hardware/sensors/BnSensors.h>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "HalProxy.h"
+#include "SensorEventStats.h"
 
 namespace aidl {
 namespace android {
@@ -57,6 +61,18 @@ class HalProxyAidl : public ::android::hardware::sensors::V2_1::implementation::
     ::ndk::ScopedAStatus unregisterDirectChannel(int32_t in_channelHandle) override;
 
     binder_status_t dump(int fd, const char **args, uint32_t numArgs) override;
+
+    // Drops the cached sensor list, called when dynamic sensors come and go.
+    void invalidateSensorList();
+    void buildSensorListLocked();
+
+    std::mutex mSensorListLock;
+    // Fixed-up list returned by getSensorsList(), valid if mSensorListValid.
+    std::vector<::aidl::android::hardware::sensors::SensorInfo> mSensorList;
+    bool mSensorListValid = false;
+
+    // Kept across initialize() calls so that dumps cover the whole lifetime of the service.
+    std::shared_ptr<SensorEventStats> mEventStats = std::make_shared<SensorEventStats>();
 };
 
 }  // namespace implementation
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include "ConvertUtils.h"
 #include "ISensorsCallbackWrapper.h"
 
@@ -38,25 +40,30 @@ static std::vector<::aidl::android::hardware::sensors::SensorInfo> convertToAidl
 class ISensorsCallbackWrapperAidl
     : public ::android::hardware::sensors::V2_1::implementation::ISensorsCallbackWrapperBase {
   public:
+    // |onSensorsChanged| runs before the framework is told about dynamic sensor changes.
     ISensorsCallbackWrapperAidl(
-            std::shared_ptr<::aidl::android::hardware::sensors::ISensorsCallback> sensorsCallback)
-        : mSensorsCallback(sensorsCallback) {}
+            std::shared_ptr<::aidl::android::hardware::sensors::ISensorsCallback> sensorsCallback,
+            std::function<void()> onSensorsChanged)
+        : mSensorsCallback(sensorsCallback), mOnSensorsChanged(std::move(onSensorsChanged)) {}
 
     ::android::hardware::Return<void> onDynamicSensorsConnected(
             const ::android::hardware::hidl_vec<::android::hardware::sensors::V2_1::SensorInfo>&
                     sensorInfos) override {
+        mOnSensorsChanged();
         mSensorsCallback->onDynamicSensorsConnected(convertToAidlSensorInfos(sensorInfos));
         return ::android::hardware::Void();
     }
 
     ::android::hardware::Return<void> onDynamicSensorsDisconnected(
             const ::android::hardware::hidl_vec<int32_t>& sensorHandles) override {
+        mOnSensorsChanged();
         mSensorsCallback->onDynamicSensorsDisconnected(sensorHandles);
         return ::android::hardware::Void();
     }
 
   private:
     std::shared_ptr<::aidl::android::hardware::sensors::ISensorsCallback> mSensorsCallback;
+    std::function<void()> mOnSensorsChanged;
 };
 
 }  // namespace implementation
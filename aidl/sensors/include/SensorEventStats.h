@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace implementation {
+
+/**
+ * Per-sensor-handle counters for events written to the event FMQ. Updated with relaxed atomics
+ * from the writing thread and read by dump(), so it can stay enabled in production.
+ */
+class SensorEventStats {
+  public:
+    SensorEventStats();
+
+    /**
+     * Records one write of |count| events. |written| is false if the write failed and wrote
+     * nothing, |blocked| is true if the write had to wait for the reader. HalProxy only writes
+     * without blocking what fits and queues the rest, but drops the events of a blocking write
+     * that fails, so those are counted as dropped. All events of a sensor in one write count as
+     * one batch of that sensor, even if other sensors' events are interleaved. Like the queue
+     * itself, this takes a single writer at a time.
+     */
+    void recordWrite(const ::android::hardware::sensors::V2_1::Event* events, size_t count,
+                     bool written, bool blocked);
+
+    /**
+     * Prints the counters of every sensor seen so far; event rates cover the time since the
+     * previous dump.
+     */
+    void dump(int fd);
+
+  private:
+    static constexpr size_t kMaxSensors = 128;
+    // Bucket 0 counts latencies under 1us, bucket i in [2^(i-1), 2^i) microseconds up to the
+    // last one, which counts everything from 2^(kLatencyBuckets-2) microseconds up.
+    static constexpr size_t kLatencyBuckets = 22;
+    static constexpr int32_t kEmptyHandle = INT32_MIN;
+
+    struct alignas(64) Slot {
+        std::atomic<int32_t> handle;
+        std::atomic<uint64_t> events;
+        std::atomic<uint64_t> batches;
+        std::atomic<uint64_t> maxBatch;
+        // Events of failed blocking writes.
+        std::atomic<uint64_t> dropped;
+        std::atomic<uint64_t> blocked;
+        std::array<std::atomic<uint64_t>, kLatencyBuckets> latency;
+        // Event count at the previous dump.
+        std::atomic<uint64_t> dumpedEvents;
+        // Only touched by recordWrite(): the write this slot last saw, and its event count in it.
+        uint64_t lastWrite;
+        uint64_t writeEvents;
+    };
+
+    // Finds or claims the slot of |handle|, nullptr once the table is full.
+    Slot* findSlot(int32_t handle);
+    static size_t latencyBucket(int64_t latencyNs);
+    // "<Nus" with the upper bound of |bucket|, ">=Nus" for the last one, "-" for no samples.
+    static std::string latencyLabel(size_t bucket);
+
+    std::array<Slot, kMaxSensors> mSlots;
+    // Numbers the writes; 0 is never used, so fresh slots have seen no write.
+    uint64_t mWrites;
+    std::atomic<uint64_t> mUntrackedEvents;
+    std::atomic<int64_t> mLastDumpNs;
+};
+
+}  // namespace implementation
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <iterator>
+#include <vector>
+
+#include "ConvertUtils.h"
+#include "LegacyConvertUtils.h"
+
+using ::aidl::android::hardware::sensors::implementation::convertToAidlEvent;
+using ::aidl::android::hardware::sensors::implementation::convertToAidlEvents;
+using ::aidl::android::hardware::sensors::implementation::convertToHidlEvent;
+using ::aidl::android::hardware::sensors::implementation::convertToHidlEvents;
+using ::aidl::android::hardware::sensors::implementation::legacyConvertToAidlEvent;
+using ::aidl::android::hardware::sensors::implementation::legacyConvertToHidlEvent;
+using AidlEvent = ::aidl::android::hardware::sensors::Event;
+using V2_1Event = ::android::hardware::sensors::V2_1::Event;
+using V2_1SensorType = ::android::hardware::sensors::V2_1::SensorType;
+
+namespace {
+
+constexpr size_t kBatch = 128;
+
+// Sensor types seen together in FIFO flushes, one per common payload kind.
+constexpr V2_1SensorType kMixTypes[] = {
+        V2_1SensorType::ACCELEROMETER,
+        V2_1SensorType::GYROSCOPE_UNCALIBRATED,
+        V2_1SensorType::GAME_ROTATION_VECTOR,
+        V2_1SensorType::LIGHT,
+        V2_1SensorType::STEP_COUNTER,
+        V2_1SensorType::MAGNETIC_FIELD,
+        V2_1SensorType::ACCELEROMETER_UNCALIBRATED,
+};
+
+// kBatch events cycling through kMixTypes in same-typed runs of |runLength|.
+std::vector<V2_1Event> makeHidlBatch(size_t runLength) {
+    std::vector<V2_1Event> events(kBatch);
+    for (size_t i = 0; i < kBatch; ++i) {
+        V2_1Event& event = events[i];
+        const size_t run = i / runLength;
+        event.timestamp = 1000000000 + static_cast<int64_t>(i) * 2500000;
+        event.sensorHandle = static_cast<int32_t>(run % std::size(kMixTypes)) + 1;
+        event.sensorType = kMixTypes[run % std::size(kMixTypes)];
+        for (size_t j = 0; j < event.u.data.size(); ++j) {
+            event.u.data[j] = 0.1f * (i + j);
+        }
+        // Keeps the Vec3 status byte a valid SensorStatus.
+        event.u.vec3.status = ::android::hardware::sensors::V1_0::SensorStatus::ACCURACY_HIGH;
+    }
+    return events;
+}
+
+std::vector<AidlEvent> makeAidlBatch(size_t runLength) {
+    const std::vector<V2_1Event> hidlEvents = makeHidlBatch(runLength);
+    std::vector<AidlEvent> events(kBatch);
+    convertToAidlEvents(hidlEvents.data(), kBatch, events.data());
+    return events;
+}
+
+void setCounters(benchmark::State& state) {
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    state.counters["cpu_per_event"] = benchmark::Counter(
+            kBatch, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+// The switch based converter, one event at a time.
+void BM_ToAidlLegacy(benchmark::State& state) {
+    const std::vector<V2_1Event> in = makeHidlBatch(state.range(0));
+    std::vector<AidlEvent> out(kBatch);
+    for (auto _ : state) {
+        for (size_t i = 0; i < kBatch; ++i) {
+            legacyConvertToAidlEvent(in[i], &out[i]);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    setCounters(state);
+}
+
+// The table driven converter, one event at a time.
+void BM_ToAidlSingle(benchmark::State& state) {
+    const std::vector<V2_1Event> in = makeHidlBatch(state.range(0));
+    std::vector<AidlEvent> out(kBatch);
+    for (auto _ : state) {
+        for (size_t i = 0; i < kBatch; ++i) {
+            convertToAidlEvent(in[i], &out[i]);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    setCounters(state);
+}
+
+// The table driven converter, one lookup per same-typed run.
+void BM_ToAidlBatch(benchmark::State& state) {
+    const std::vector<V2_1Event> in = makeHidlBatch(state.range(0));
+    std::vector<AidlEvent> out(kBatch);
+    for (auto _ : state) {
+        convertToAidlEvents(in.data(), kBatch, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    setCounters(state);
+}
+
+void BM_ToHidlLegacy(benchmark::State& state) {
+    const std::vector<AidlEvent> in = makeAidlBatch(state.range(0));
+    std::vector<V2_1Event> out(kBatch);
+    for (auto _ : state) {
+        for (size_t i = 0; i < kBatch; ++i) {
+            legacyConvertToHidlEvent(in[i], &out[i]);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    setCounters(state);
+}
+
+void BM_ToHidlSingle(benchmark::State& state) {
+    const std::vector<AidlEvent> in = makeAidlBatch(state.range(0));
+    std::vector<V2_1Event> out(kBatch);
+    for (auto _ : state) {
+        for (size_t i = 0; i < kBatch; ++i) {
+            convertToHidlEvent(in[i], &out[i]);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    setCounters(state);
+}
+
+void BM_ToHidlBatch(benchmark::State& state) {
+    const std::vector<AidlEvent> in = makeAidlBatch(state.range(0));
+    std::vector<V2_1Event> out(kBatch);
+    for (auto _ : state) {
+        convertToHidlEvents(in.data(), kBatch, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    setCounters(state);
+}
+
+// Run length 1 alternates types on every event; kBatch is a single run.
+void runLengthArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t runLength : {1, 4, 16, static_cast<int64_t>(kBatch)}) {
+        b->Arg(runLength);
+    }
+    b->ArgName("run");
+}
+
+BENCHMARK(BM_ToAidlLegacy)->Apply(runLengthArgs);
+BENCHMARK(BM_ToAidlSingle)->Apply(runLengthArgs);
+BENCHMARK(BM_ToAidlBatch)->Apply(runLengthArgs);
+BENCHMARK(BM_ToHidlLegacy)->Apply(runLengthArgs);
+BENCHMARK(BM_ToHidlSingle)->Apply(runLengthArgs);
+BENCHMARK(BM_ToHidlBatch)->Apply(runLengthArgs);
+
+}  // namespace
+
+// main() comes from EventMessageQueueWrapperAidl_benchmark.cpp.
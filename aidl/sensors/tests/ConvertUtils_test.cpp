@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "ConvertUtils.h"
+#include "LegacyConvertUtils.h"
+
+using ::aidl::android::hardware::sensors::AdditionalInfo;
+using ::aidl::android::hardware::sensors::implementation::convertToAidlEvent;
+using ::aidl::android::hardware::sensors::implementation::convertToAidlEvents;
+using ::aidl::android::hardware::sensors::implementation::convertToHidlEvent;
+using ::aidl::android::hardware::sensors::implementation::convertToHidlEvents;
+using ::aidl::android::hardware::sensors::implementation::legacyConvertToAidlEvent;
+using ::aidl::android::hardware::sensors::implementation::legacyConvertToHidlEvent;
+using AidlEvent = ::aidl::android::hardware::sensors::Event;
+using AidlSensorStatus = ::aidl::android::hardware::sensors::SensorStatus;
+using AidlSensorType = ::aidl::android::hardware::sensors::SensorType;
+using V1_0SensorStatus = ::android::hardware::sensors::V1_0::SensorStatus;
+using V2_1Event = ::android::hardware::sensors::V2_1::Event;
+using V2_1SensorType = ::android::hardware::sensors::V2_1::SensorType;
+
+namespace {
+
+constexpr int32_t kDevicePrivateBase = static_cast<int32_t>(AidlSensorType::DEVICE_PRIVATE_BASE);
+
+// Every sensor type the legacy converter handles, which covers every payload
+// kind of the table driven one.
+const std::vector<int32_t> kValidTypes = [] {
+    std::vector<int32_t> types;
+    for (AidlSensorType type : {
+                 AidlSensorType::META_DATA,
+                 AidlSensorType::ACCELEROMETER,
+                 AidlSensorType::MAGNETIC_FIELD,
+                 AidlSensorType::ORIENTATION,
+                 AidlSensorType::GYROSCOPE,
+                 AidlSensorType::LIGHT,
+                 AidlSensorType::PRESSURE,
+                 AidlSensorType::PROXIMITY,
+                 AidlSensorType::GRAVITY,
+                 AidlSensorType::LINEAR_ACCELERATION,
+                 AidlSensorType::ROTATION_VECTOR,
+                 AidlSensorType::RELATIVE_HUMIDITY,
+                 AidlSensorType::AMBIENT_TEMPERATURE,
+                 AidlSensorType::MAGNETIC_FIELD_UNCALIBRATED,
+                 AidlSensorType::GAME_ROTATION_VECTOR,
+                 AidlSensorType::GYROSCOPE_UNCALIBRATED,
+                 AidlSensorType::SIGNIFICANT_MOTION,
+                 AidlSensorType::STEP_DETECTOR,
+                 AidlSensorType::STEP_COUNTER,
+                 AidlSensorType::GEOMAGNETIC_ROTATION_VECTOR,
+                 AidlSensorType::HEART_RATE,
+                 AidlSensorType::TILT_DETECTOR,
+                 AidlSensorType::WAKE_GESTURE,
+                 AidlSensorType::GLANCE_GESTURE,
+                 AidlSensorType::PICK_UP_GESTURE,
+                 AidlSensorType::WRIST_TILT_GESTURE,
+                 AidlSensorType::DEVICE_ORIENTATION,
+                 AidlSensorType::POSE_6DOF,
+                 AidlSensorType::STATIONARY_DETECT,
+                 AidlSensorType::MOTION_DETECT,
+                 AidlSensorType::HEART_BEAT,
+                 AidlSensorType::DYNAMIC_SENSOR_META,
+                 AidlSensorType::ADDITIONAL_INFO,
+                 AidlSensorType::LOW_LATENCY_OFFBODY_DETECT,
+                 AidlSensorType::ACCELEROMETER_UNCALIBRATED,
+                 AidlSensorType::HINGE_ANGLE,
+                 AidlSensorType::HEAD_TRACKER,
+         }) {
+        types.push_back(static_cast<int32_t>(type));
+    }
+    // Device private types carry raw data.
+    types.push_back(kDevicePrivateBase);
+    types.push_back(kDevicePrivateBase + 100);
+    return types;
+}();
+
+// Types neither converter knows: past the last handled public type, the end
+// of the lookup table, negative, and just below the private range.
+const std::vector<int32_t> kInvalidTypes = {38, 63, 64, -1, kDevicePrivateBase - 1};
+
+void fill(V2_1Event* event, uint8_t pattern) {
+    memset(static_cast<void*>(event), pattern, sizeof(*event));
+}
+
+// A HIDL event of |type| with every payload float randomized. Fields that
+// alias the floats (status bytes, counters, ids) end up with arbitrary bits,
+// except for the ones whose every bit pattern is not a valid value.
+V2_1Event randomHidlEvent(std::mt19937* rng, int32_t type) {
+    std::uniform_real_distribution<float> value(-1000.0f, 1000.0f);
+    V2_1Event event;
+    fill(&event, 0);
+    event.timestamp = std::uniform_int_distribution<int64_t>()(*rng);
+    event.sensorHandle = static_cast<int32_t>((*rng)());
+    event.sensorType = static_cast<V2_1SensorType>(type);
+    for (size_t i = 0; i < event.u.data.size(); ++i) {
+        event.u.data[i] = value(*rng);
+    }
+    if (type == static_cast<int32_t>(AidlSensorType::DYNAMIC_SENSOR_META)) {
+        event.u.dynamic.connected = (*rng)() & 1;
+    } else if (type == static_cast<int32_t>(AidlSensorType::HEAD_TRACKER)) {
+        // discontinuityCount is an int32 stored in the bits of data[6].
+        const int32_t discontinuityCount = static_cast<int32_t>((*rng)());
+        memcpy(&event.u.data[6], &discontinuityCount, sizeof(discontinuityCount));
+    }
+    return event;
+}
+
+// A random AIDL event of |type|, as a HIDL event converted by the legacy code.
+AidlEvent randomAidlEvent(std::mt19937* rng, int32_t type) {
+    AidlEvent event;
+    legacyConvertToAidlEvent(randomHidlEvent(rng, type), &event);
+    return event;
+}
+
+void expectSameAidlEvent(const V2_1Event& hidlEvent) {
+    AidlEvent expected;
+    AidlEvent actual;
+    legacyConvertToAidlEvent(hidlEvent, &expected);
+    convertToAidlEvent(hidlEvent, &actual);
+    EXPECT_TRUE(expected == actual) << "sensor type " << static_cast<int32_t>(hidlEvent.sensorType)
+                                    << "\nexpected: " << expected.toString()
+                                    << "\nactual:   " << actual.toString();
+}
+
+// Compares |actual| with what the legacy converter makes of |aidlEvent|. The
+// legacy converter writes field by field, so running it on outputs filled
+// with two different patterns tells the bytes it writes from the ones it
+// leaves alone (padding, the unused tail of the payload); only the former
+// have to match.
+void expectSameHidlEvent(const AidlEvent& aidlEvent, const V2_1Event& actual) {
+    V2_1Event zeros;
+    V2_1Event ones;
+    fill(&zeros, 0x00);
+    fill(&ones, 0xff);
+    legacyConvertToHidlEvent(aidlEvent, &zeros);
+    legacyConvertToHidlEvent(aidlEvent, &ones);
+
+    const int32_t type = static_cast<int32_t>(aidlEvent.sensorType);
+    EXPECT_EQ(zeros.timestamp, actual.timestamp) << "sensor type " << type;
+    EXPECT_EQ(zeros.sensorHandle, actual.sensorHandle) << "sensor type " << type;
+    EXPECT_EQ(zeros.sensorType, actual.sensorType) << "sensor type " << type;
+    const auto* expectedBytes = reinterpret_cast<const uint8_t*>(&zeros.u);
+    const auto* unwrittenBytes = reinterpret_cast<const uint8_t*>(&ones.u);
+    const auto* actualBytes = reinterpret_cast<const uint8_t*>(&actual.u);
+    for (size_t i = 0; i < sizeof(zeros.u); ++i) {
+        if (expectedBytes[i] != unwrittenBytes[i]) {
+            continue;
+        }
+        EXPECT_EQ(expectedBytes[i], actualBytes[i]) << "sensor type " << type << " byte " << i;
+    }
+}
+
+void expectSameHidlEvent(const AidlEvent& aidlEvent) {
+    V2_1Event actual;
+    fill(&actual, 0x5a);
+    convertToHidlEvent(aidlEvent, &actual);
+    expectSameHidlEvent(aidlEvent, actual);
+}
+
+TEST(ConvertUtilsTest, ToAidlMatchesLegacyForEveryType) {
+    std::mt19937 rng(1);
+    for (int32_t type : kValidTypes) {
+        for (int i = 0; i < 100; ++i) {
+            expectSameAidlEvent(randomHidlEvent(&rng, type));
+        }
+    }
+}
+
+TEST(ConvertUtilsTest, ToHidlMatchesLegacyForEveryType) {
+    std::mt19937 rng(2);
+    for (int32_t type : kValidTypes) {
+        for (int i = 0; i < 100; ++i) {
+            expectSameHidlEvent(randomAidlEvent(&rng, type));
+        }
+    }
+}
+
+TEST(ConvertUtilsTest, ToHidlMatchesLegacyForFloatAdditionalInfo) {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> value(-1000.0f, 1000.0f);
+    AidlEvent event = randomAidlEvent(&rng, static_cast<int32_t>(AidlSensorType::ADDITIONAL_INFO));
+    AdditionalInfo additionalInfo = event.payload.get<AidlEvent::EventPayload::additional>();
+    AdditionalInfo::AdditionalInfoPayload::FloatValues floatValues;
+    for (float& v : floatValues.values) {
+        v = value(rng);
+    }
+    additionalInfo.payload.set<AdditionalInfo::AdditionalInfoPayload::dataFloat>(floatValues);
+    event.payload.set<AidlEvent::EventPayload::additional>(additionalInfo);
+    expectSameHidlEvent(event);
+}
+
+TEST(ConvertUtilsTest, HeadTrackerKeepsDiscontinuityCountBits) {
+    for (int32_t discontinuityCount : {0, 1, -1, INT32_MIN, INT32_MAX, 0x7fc00000}) {
+        V2_1Event hidlEvent;
+        fill(&hidlEvent, 0);
+        hidlEvent.sensorType = static_cast<V2_1SensorType>(AidlSensorType::HEAD_TRACKER);
+        memcpy(&hidlEvent.u.data[6], &discontinuityCount, sizeof(discontinuityCount));
+
+        AidlEvent aidlEvent;
+        convertToAidlEvent(hidlEvent, &aidlEvent);
+        EXPECT_EQ(discontinuityCount,
+                  aidlEvent.payload.get<AidlEvent::EventPayload::headTracker>().discontinuityCount);
+
+        V2_1Event roundTrip;
+        fill(&roundTrip, 0);
+        convertToHidlEvent(aidlEvent, &roundTrip);
+        int32_t bits;
+        memcpy(&bits, &roundTrip.u.data[6], sizeof(bits));
+        EXPECT_EQ(discontinuityCount, bits);
+    }
+}
+
+// Mixed batches with same-typed runs of random length, converted both ways
+// through the batch entry points.
+TEST(ConvertUtilsTest, BatchesMatchLegacy) {
+    std::mt19937 rng(4);
+    std::uniform_int_distribution<size_t> pickType(0, kValidTypes.size() - 1);
+    std::uniform_int_distribution<size_t> runLength(1, 32);
+    std::vector<V2_1Event> hidlEvents;
+    while (hidlEvents.size() < 2000) {
+        const int32_t type = kValidTypes[pickType(rng)];
+        for (size_t n = runLength(rng); n > 0; --n) {
+            hidlEvents.push_back(randomHidlEvent(&rng, type));
+        }
+    }
+
+    std::vector<AidlEvent> aidlEvents(hidlEvents.size());
+    convertToAidlEvents(hidlEvents.data(), hidlEvents.size(), aidlEvents.data());
+    for (size_t i = 0; i < hidlEvents.size(); ++i) {
+        AidlEvent expected;
+        legacyConvertToAidlEvent(hidlEvents[i], &expected);
+        EXPECT_TRUE(expected == aidlEvents[i]) << "event " << i;
+    }
+
+    std::vector<V2_1Event> converted(aidlEvents.size());
+    for (V2_1Event& event : converted) {
+        fill(&event, 0x5a);
+    }
+    convertToHidlEvents(aidlEvents.data(), aidlEvents.size(), converted.data());
+    for (size_t i = 0; i < aidlEvents.size(); ++i) {
+        expectSameHidlEvent(aidlEvents[i], converted[i]);
+    }
+}
+
+// Long same-typed runs exercise the per-kind loops past a few iterations.
+TEST(ConvertUtilsTest, LongRunsOfEachKindMatchLegacy) {
+    std::mt19937 rng(5);
+    for (int32_t type : kValidTypes) {
+        for (size_t length : {1, 2, 3, 64, 127, 128}) {
+            std::vector<V2_1Event> hidlEvents;
+            for (size_t i = 0; i < length; ++i) {
+                hidlEvents.push_back(randomHidlEvent(&rng, type));
+            }
+            std::vector<AidlEvent> aidlEvents(length);
+            convertToAidlEvents(hidlEvents.data(), length, aidlEvents.data());
+            std::vector<V2_1Event> converted(length);
+            convertToHidlEvents(aidlEvents.data(), length, converted.data());
+            for (size_t i = 0; i < length; ++i) {
+                AidlEvent expected;
+                legacyConvertToAidlEvent(hidlEvents[i], &expected);
+                EXPECT_TRUE(expected == aidlEvents[i])
+                        << "sensor type " << type << " run " << length << " event " << i;
+                expectSameHidlEvent(aidlEvents[i], converted[i]);
+            }
+        }
+    }
+}
+
+// The status byte of Vec3 payloads is copied along with the floats.
+TEST(ConvertUtilsTest, Vec3StatusRoundTrips) {
+    for (AidlSensorStatus status :
+         {AidlSensorStatus::NO_CONTACT, AidlSensorStatus::UNRELIABLE,
+          AidlSensorStatus::ACCURACY_LOW, AidlSensorStatus::ACCURACY_MEDIUM,
+          AidlSensorStatus::ACCURACY_HIGH}) {
+        for (AidlSensorType type : {AidlSensorType::ACCELEROMETER, AidlSensorType::MAGNETIC_FIELD,
+                                    AidlSensorType::ORIENTATION, AidlSensorType::GYROSCOPE,
+                                    AidlSensorType::GRAVITY, AidlSensorType::LINEAR_ACCELERATION}) {
+            V2_1Event hidlEvent;
+            fill(&hidlEvent, 0);
+            hidlEvent.sensorType = static_cast<V2_1SensorType>(type);
+            hidlEvent.u.vec3.x = 1.0f;
+            hidlEvent.u.vec3.y = -2.0f;
+            hidlEvent.u.vec3.z = 3.5f;
+            hidlEvent.u.vec3.status = static_cast<V1_0SensorStatus>(status);
+
+            AidlEvent aidlEvent;
+            convertToAidlEvent(hidlEvent, &aidlEvent);
+            const auto& vec3 = aidlEvent.payload.get<AidlEvent::EventPayload::vec3>();
+            EXPECT_EQ(status, vec3.status);
+            EXPECT_EQ(1.0f, vec3.x);
+            EXPECT_EQ(-2.0f, vec3.y);
+            EXPECT_EQ(3.5f, vec3.z);
+
+            V2_1Event roundTrip;
+            fill(&roundTrip, 0xff);
+            convertToHidlEvent(aidlEvent, &roundTrip);
+            EXPECT_EQ(hidlEvent.u.vec3.status, roundTrip.u.vec3.status);
+            EXPECT_EQ(hidlEvent.u.vec3.x, roundTrip.u.vec3.x);
+            EXPECT_EQ(hidlEvent.u.vec3.y, roundTrip.u.vec3.y);
+            EXPECT_EQ(hidlEvent.u.vec3.z, roundTrip.u.vec3.z);
+        }
+    }
+}
+
+TEST(ConvertUtilsDeathTest, InvalidTypesAbortLikeLegacy) {
+    for (int32_t type : kInvalidTypes) {
+        V2_1Event hidlEvent;
+        fill(&hidlEvent, 0);
+        hidlEvent.sensorType = static_cast<V2_1SensorType>(type);
+        AidlEvent aidlEvent;
+        aidlEvent.sensorType = static_cast<AidlSensorType>(type);
+        V2_1Event hidlOut;
+        AidlEvent aidlOut;
+
+        EXPECT_DEATH(legacyConvertToAidlEvent(hidlEvent, &aidlOut), "") << "sensor type " << type;
+        EXPECT_DEATH(convertToAidlEvent(hidlEvent, &aidlOut), "") << "sensor type " << type;
+        EXPECT_DEATH(legacyConvertToHidlEvent(aidlEvent, &hidlOut), "") << "sensor type " << type;
+        EXPECT_DEATH(convertToHidlEvent(aidlEvent, &hidlOut), "") << "sensor type " << type;
+    }
+}
+
+}  // namespace
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <fmq/AidlMessageQueue.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "ConvertUtils.h"
+#include "EventMessageQueueWrapperAidl.h"
+#include "SensorEventStats.h"
+
+using ::aidl::android::hardware::common::fmq::SynchronizedReadWrite;
+using ::aidl::android::hardware::sensors::implementation::convertToAidlEvents;
+using ::aidl::android::hardware::sensors::implementation::EventMessageQueueWrapperAidl;
+using ::aidl::android::hardware::sensors::implementation::SensorEventStats;
+using ::android::hardware::sensors::V1_0::SensorStatus;
+using ::android::hardware::sensors::V2_1::implementation::MAX_RECEIVE_BUFFER_EVENT_COUNT;
+using AidlEvent = ::aidl::android::hardware::sensors::Event;
+using AidlEventQueue = ::android::AidlMessageQueue<AidlEvent, SynchronizedReadWrite>;
+using V2_1Event = ::android::hardware::sensors::V2_1::Event;
+using V2_1SensorType = ::android::hardware::sensors::V2_1::SensorType;
+
+namespace {
+
+// Room for two full batches, so writes never fail for lack of space.
+constexpr size_t kQueueSize = 2 * MAX_RECEIVE_BUFFER_EVENT_COUNT;
+
+// A FIFO flush of |count| accelerometer events, or accelerometer and
+// gyroscope events interleaved if |interleaved| is set.
+std::vector<V2_1Event> makeBatch(size_t count, bool interleaved) {
+    std::vector<V2_1Event> events(count);
+    for (size_t i = 0; i < count; ++i) {
+        const bool gyro = interleaved && (i % 2 == 1);
+        V2_1Event& event = events[i];
+        event.timestamp = 1000000000 + static_cast<int64_t>(i) * 2500000;
+        event.sensorHandle = gyro ? 2 : 1;
+        event.sensorType = gyro ? V2_1SensorType::GYROSCOPE : V2_1SensorType::ACCELEROMETER;
+        event.u.vec3.x = 0.1f * i;
+        event.u.vec3.y = 9.8f;
+        event.u.vec3.z = -0.1f * i;
+        event.u.vec3.status = SensorStatus::ACCURACY_HIGH;
+    }
+    return events;
+}
+
+void setCounters(benchmark::State& state, size_t batch) {
+    state.SetItemsProcessed(state.iterations() * batch);
+    // CPU time per event.
+    state.counters["cpu_per_event"] = benchmark::Counter(
+            batch, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+// The path before direct writes: convert into an intermediate buffer, then
+// let the FMQ copy the buffer into queue memory.
+void BM_WriteBuffered(benchmark::State& state) {
+    const size_t batch = state.range(0);
+    const std::vector<V2_1Event> events = makeBatch(batch, state.range(1));
+    AidlEventQueue queue(kQueueSize, true /* configureEventFlagWord */);
+    AidlEventQueue reader(queue.dupeDesc(), false /* resetPointers */);
+    std::array<AidlEvent, MAX_RECEIVE_BUFFER_EVENT_COUNT> buffer;
+    std::vector<AidlEvent> drained(batch);
+
+    for (auto _ : state) {
+        convertToAidlEvents(events.data(), batch, buffer.data());
+        if (!queue.write(buffer.data(), batch)) {
+            state.SkipWithError("write failed");
+            break;
+        }
+        reader.read(drained.data(), batch);
+    }
+    setCounters(state, batch);
+}
+
+// EventMessageQueueWrapperAidl::write(), which converts straight into the
+// reserved queue slots. This includes updating its SensorEventStats.
+void BM_WriteInPlace(benchmark::State& state) {
+    const size_t batch = state.range(0);
+    const std::vector<V2_1Event> events = makeBatch(batch, state.range(1));
+    auto queue = std::make_unique<AidlEventQueue>(kQueueSize, true /* configureEventFlagWord */);
+    AidlEventQueue reader(queue->dupeDesc(), false /* resetPointers */);
+    EventMessageQueueWrapperAidl wrapper(queue, std::make_shared<SensorEventStats>());
+    std::vector<AidlEvent> drained(batch);
+
+    for (auto _ : state) {
+        if (!wrapper.write(events.data(), batch)) {
+            state.SkipWithError("write failed");
+            break;
+        }
+        reader.read(drained.data(), batch);
+    }
+    setCounters(state, batch);
+}
+
+// The share of BM_WriteInPlace spent updating SensorEventStats.
+void BM_RecordWrite(benchmark::State& state) {
+    const size_t batch = state.range(0);
+    const std::vector<V2_1Event> events = makeBatch(batch, state.range(1));
+    SensorEventStats stats;
+
+    for (auto _ : state) {
+        stats.recordWrite(events.data(), batch, true /* written */, false /* blocked */);
+    }
+    setCounters(state, batch);
+}
+
+// Both paths also pay for the reader draining the queue, so the difference
+// between them is the intermediate copy.
+void eventQueueArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t interleaved : {0, 1}) {
+        for (int64_t batch : {1, 16, 64, static_cast<int64_t>(MAX_RECEIVE_BUFFER_EVENT_COUNT)}) {
+            b->Args({batch, interleaved});
+        }
+    }
+    b->ArgNames({"batch", "interleaved"});
+}
+
+BENCHMARK(BM_WriteBuffered)->Apply(eventQueueArgs);
+BENCHMARK(BM_WriteInPlace)->Apply(eventQueueArgs);
+BENCHMARK(BM_RecordWrite)->Apply(eventQueueArgs);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <utils/SystemClock.h>
+
+#include <string>
+#include <vector>
+
+#include "SensorEventStats.h"
+
+using ::aidl::android::hardware::sensors::implementation::SensorEventStats;
+using V2_1Event = ::android::hardware::sensors::V2_1::Event;
+using V2_1SensorType = ::android::hardware::sensors::V2_1::SensorType;
+
+namespace {
+
+// Events with the given sensor handles, sampled |ageNs| ago.
+std::vector<V2_1Event> makeEvents(const std::vector<int32_t>& handles, int64_t ageNs = 1000000) {
+    const int64_t now = ::android::elapsedRealtimeNano();
+    std::vector<V2_1Event> events(handles.size());
+    for (size_t i = 0; i < handles.size(); ++i) {
+        events[i].timestamp = now - ageNs;
+        events[i].sensorHandle = handles[i];
+        events[i].sensorType = V2_1SensorType::ACCELEROMETER;
+    }
+    return events;
+}
+
+void record(SensorEventStats* stats, const std::vector<V2_1Event>& events, bool written = true,
+            bool blocked = false) {
+    stats->recordWrite(events.data(), events.size(), written, blocked);
+}
+
+std::string dump(SensorEventStats* stats) {
+    int fds[2];
+    EXPECT_EQ(0, pipe(fds));
+    stats->dump(fds[1]);
+    close(fds[1]);
+    std::string out;
+    EXPECT_TRUE(::android::base::ReadFdToString(fds[0], &out));
+    close(fds[0]);
+    return out;
+}
+
+// The dump line of |handle|, empty if there is none.
+std::string dumpLine(SensorEventStats* stats, int32_t handle) {
+    const std::string out = dump(stats);
+    const std::string prefix = ::android::base::StringPrintf("  0x%08x: ", handle);
+    const size_t start = out.find(prefix);
+    if (start == std::string::npos) {
+        return "";
+    }
+    return out.substr(start, out.find('\n', start) - start);
+}
+
+TEST(SensorEventStatsTest, InterleavedSensorsCountOneBatchPerWrite) {
+    SensorEventStats stats;
+    record(&stats, makeEvents({1, 2, 1, 2, 1}));
+    EXPECT_NE(std::string::npos,
+              dumpLine(&stats, 1).find("3 events in 1 batches (avg 3.0, max 3)"));
+    EXPECT_NE(std::string::npos,
+              dumpLine(&stats, 2).find("2 events in 1 batches (avg 2.0, max 2)"));
+}
+
+TEST(SensorEventStatsTest, MaxBatchIsTheLargestWrite) {
+    SensorEventStats stats;
+    record(&stats, makeEvents({1, 1}));
+    record(&stats, makeEvents({1, 2, 1, 1, 2, 1, 1}));
+    record(&stats, makeEvents({1}));
+    EXPECT_NE(std::string::npos,
+              dumpLine(&stats, 1).find("8 events in 3 batches (avg 2.7, max 5)"));
+}
+
+// HalProxy retries the events of a failed write that did not block.
+TEST(SensorEventStatsTest, FailedWritesAreNotCounted) {
+    SensorEventStats stats;
+    record(&stats, makeEvents({1, 2, 1}), false /* written */);
+    const std::string line = dumpLine(&stats, 1);
+    EXPECT_NE(std::string::npos, line.find("0 events in 0 batches")) << line;
+    EXPECT_NE(std::string::npos, line.find("0 dropped")) << line;
+    EXPECT_NE(std::string::npos, line.find("latency p50 - p99 -")) << line;
+}
+
+// HalProxy drops the events of a failed blocking write.
+TEST(SensorEventStatsTest, FailedBlockingWritesCountDroppedEvents) {
+    SensorEventStats stats;
+    record(&stats, makeEvents({1, 2, 1}), false /* written */, true /* blocked */);
+    const std::string line = dumpLine(&stats, 1);
+    EXPECT_NE(std::string::npos, line.find("0 events in 0 batches")) << line;
+    EXPECT_NE(std::string::npos, line.find("2 dropped, 0 blocked")) << line;
+    EXPECT_NE(std::string::npos, dumpLine(&stats, 2).find("1 dropped, 0 blocked"));
+}
+
+TEST(SensorEventStatsTest, BlockedWritesCountPerBatch) {
+    SensorEventStats stats;
+    record(&stats, makeEvents({1, 2, 1}), true /* written */, true /* blocked */);
+    record(&stats, makeEvents({1}));
+    EXPECT_NE(std::string::npos, dumpLine(&stats, 1).find("0 dropped, 1 blocked"));
+}
+
+TEST(SensorEventStatsTest, LatencyLabels) {
+    SensorEventStats stats;
+    // 3ms falls in [2048us, 4096us).
+    record(&stats, makeEvents({1}, 3000000));
+    EXPECT_NE(std::string::npos, dumpLine(&stats, 1).find("latency p50 <4096us p99 <4096us"));
+
+    // Anything from 2^20us up lands in the open ended last bucket.
+    record(&stats, makeEvents({2}, 10000000000));
+    EXPECT_NE(std::string::npos,
+              dumpLine(&stats, 2).find("latency p50 >=1048576us p99 >=1048576us"));
+}
+
+TEST(SensorEventStatsTest, FlushCompleteEventsHaveNoLatency) {
+    SensorEventStats stats;
+    std::vector<V2_1Event> events = makeEvents({1});
+    events[0].sensorType = V2_1SensorType::META_DATA;
+    events[0].timestamp = 0;
+    record(&stats, events);
+    const std::string line = dumpLine(&stats, 1);
+    EXPECT_NE(std::string::npos, line.find("1 events in 1 batches")) << line;
+    EXPECT_NE(std::string::npos, line.find("latency p50 - p99 -")) << line;
+}
+
+TEST(SensorEventStatsTest, SensorsBeyondTheTableAreUntracked) {
+    SensorEventStats stats;
+    std::vector<int32_t> handles;
+    for (int32_t handle = 1; handle <= 200; ++handle) {
+        handles.push_back(handle);
+    }
+    record(&stats, makeEvents(handles));
+    EXPECT_NE(std::string::npos, dump(&stats).find("  72 events from untracked sensors\n"));
+}
+
+}  // namespace